@@ -0,0 +1,157 @@
+// LED grid mapping and frame updates
+//
+// Tiles map a rectangle of the letter grid onto a run of LEDs in leds[].
+// Chained panels are consecutive runs on one strip; parallel strips are
+// separate runs that each get their own FastLED.addLeds(). mapTiles() builds
+// the grid position -> LED index table once at boot.
+//
+// A frame keeps the LEDs set for the next frame and the LEDs lit in the
+// current one, so an update only touches LEDs that change instead of walking
+// the whole strip.
+
+#ifndef LED_GRID_H
+#define LED_GRID_H
+
+#include <FastLED.h>
+
+typedef struct Tiles {
+  int row;              // first grid row covered by the tile
+  int col;              // first grid col covered by the tile
+  int rows;
+  int cols;
+  int firstLed;         // index in leds[] of the tile's first LED
+  boolean snake;        // snake LEDs for cleaner wiring; odd numbered lines are reversed
+  boolean flipRows;     // wiring starts at the bottom of the tile
+  boolean flipCols;     // wiring starts at the right of the tile
+  boolean columnMajor;  // wiring runs along columns instead of rows
+} Tile;
+
+// First problem mapTiles() found
+typedef struct LedMapErrors {
+  const char* reason;
+  int tile;
+  int row;
+  int col;
+  int ledNum;
+} LedMapError;
+
+// Fill ledMap (gridRows x gridCols) from the tiles, -1 where no LED is wired.
+// Returns the number of problems: tiles outside the grid or overlapping each
+// other, LEDs out of range and LEDs wired to more than one grid position.
+int mapTiles(const Tile* tiles, int numTiles, int16_t* ledMap, int gridRows, int gridCols, int numLeds,
+             LedMapError* error) {
+  int errors = 0;
+  auto fail = [&](const char* reason, int tile, int row, int col, int ledNum) {
+    if (errors++ == 0 && error != NULL) {
+      *error = { reason, tile, row, col, ledNum };
+    }
+  };
+
+  for (int i = 0; i < gridRows * gridCols; i++) {
+    ledMap[i] = -1;
+  }
+  // one bit per LED that is already wired to a grid position
+  uint32_t* ledUsed = (uint32_t*) calloc((numLeds + 31) / 32, sizeof(uint32_t));
+
+  for (int t = 0; t < numTiles; t++) {
+    const Tile& tile = tiles[t];
+
+    if (tile.row < 0 || tile.col < 0 || tile.row + tile.rows > gridRows || tile.col + tile.cols > gridCols) {
+      fail("tile outside the grid", t, tile.row, tile.col, -1);
+      continue;
+    }
+
+    for (int r = 0; r < tile.rows; r++) {
+      for (int c = 0; c < tile.cols; c++) {
+        int wiredRow = tile.flipRows ? (tile.rows - 1 - r) : r;
+        int wiredCol = tile.flipCols ? (tile.cols - 1 - c) : c;
+        int line = tile.columnMajor ? wiredCol : wiredRow;
+        int pos = tile.columnMajor ? wiredRow : wiredCol;
+        int lineLength = tile.columnMajor ? tile.rows : tile.cols;
+
+        if (tile.snake && (line % 2 == 1)) {
+          pos = lineLength - 1 - pos;
+        }
+
+        int row = tile.row + r;
+        int col = tile.col + c;
+        int ledNum = tile.firstLed + (line * lineLength) + pos;
+        int16_t& cell = ledMap[(row * gridCols) + col];
+
+        if (ledNum < 0 || ledNum >= numLeds) {
+          fail("LED out of range", t, row, col, ledNum);
+        } else if (cell >= 0) {
+          fail("tiles overlap", t, row, col, ledNum);
+        } else if (ledUsed[ledNum / 32] & (1UL << (ledNum % 32))) {
+          fail("LED wired to two grid positions", t, row, col, ledNum);
+        } else {
+          ledUsed[ledNum / 32] |= 1UL << (ledNum % 32);
+          cell = ledNum;
+        }
+      }
+    }
+  }
+
+  free(ledUsed);
+  return errors;
+}
+
+typedef struct LedFrames {
+  int numLeds;
+  CRGB* leds;
+  boolean* buffer;      // LEDs set for the next frame
+  int16_t* lit;         // LEDs set in buffer, in the order they were set
+  int numLit;
+  int16_t* shown;       // LEDs lit in the current frame
+  int numShown;
+  uint32_t* mask;       // bit per LED lit in the current frame
+} LedFrame;
+
+inline void frameSetLed(LedFrame& frame, int ledNum) {
+  if (frame.buffer[ledNum]) {
+    return;
+  }
+  frame.buffer[ledNum] = true;
+  frame.lit[frame.numLit++] = ledNum;
+}
+
+inline void frameClear(LedFrame& frame) {
+  for (int i = 0; i < frame.numLit; i++) {
+    frame.buffer[frame.lit[i]] = false;
+  }
+  frame.numLit = 0;
+}
+
+// Make the LEDs set in the buffer the current frame and clear the buffer.
+// Returns whether any LED changed, i.e. whether the strip needs a show().
+inline boolean frameUpdate(LedFrame& frame) {
+  boolean changed = false;
+
+  // turn off LEDs that are not part of the new frame
+  for (int i = 0; i < frame.numShown; i++) {
+    int ledNum = frame.shown[i];
+    if (!frame.buffer[ledNum]) {
+      frame.leds[ledNum] = CRGB::Black;
+      frame.mask[ledNum / 32] &= ~(1UL << (ledNum % 32));
+      changed = true;
+    }
+  }
+
+  // turn on the new frame and reset buffer
+  for (int i = 0; i < frame.numLit; i++) {
+    int ledNum = frame.lit[i];
+    if (frame.leds[ledNum] != CRGB(CRGB::White)) {
+      frame.leds[ledNum] = CRGB::White;
+      frame.mask[ledNum / 32] |= 1UL << (ledNum % 32);
+      changed = true;
+    }
+    frame.buffer[ledNum] = false;
+    frame.shown[i] = ledNum;
+  }
+  frame.numShown = frame.numLit;
+  frame.numLit = 0;
+
+  return changed;
+}
+
+#endif
@@ -0,0 +1,60 @@
+// Motion edge queue
+//
+// Motion edges are timestamped by the interrupt handler and drained by loop().
+// Single producer (ISR) and single consumer (loop), so head and tail are each
+// written by one side only and no lock is needed. When the queue is full the
+// edge is dropped and counted instead of blocking the ISR.
+
+#ifndef MOTION_QUEUE_H
+#define MOTION_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+const uint32_t MOTION_QUEUE_SIZE = 16; // power of two
+
+typedef struct MotionEdges {
+  unsigned long ms;
+  boolean motion;
+} MotionEdge;
+
+typedef struct MotionQueues {
+  MotionEdge edges[MOTION_QUEUE_SIZE];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> dropped;
+} MotionQueue;
+
+// Producer side, safe to call from an ISR. Returns false if the edge was dropped.
+inline boolean IRAM_ATTR motionQueuePush(MotionQueue& queue, unsigned long ms, boolean motion) {
+  uint32_t head = queue.head.load(std::memory_order_relaxed);
+  if (head - queue.tail.load(std::memory_order_acquire) == MOTION_QUEUE_SIZE) {
+    queue.dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  MotionEdge& edge = queue.edges[head % MOTION_QUEUE_SIZE];
+  edge.ms = ms;
+  edge.motion = motion;
+  queue.head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// Consumer side. Returns false when the queue is empty.
+inline boolean motionQueuePop(MotionQueue& queue, MotionEdge& edge) {
+  uint32_t tail = queue.tail.load(std::memory_order_relaxed);
+  if (tail == queue.head.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  edge = queue.edges[tail % MOTION_QUEUE_SIZE];
+  queue.tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// Consumer side. Edges dropped since the last call.
+inline uint32_t motionQueueTakeDropped(MotionQueue& queue) {
+  return queue.dropped.exchange(0, std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,314 @@
+// Streaming OTA receiver
+//
+// Receives compressed firmware images built by tools/ota_pack.py. An image is
+// cut into sector sized chunks that are each raw deflate compressed and
+// optionally xor'd with the same sector of the running image (a delta), so a
+// chunk is decoded with two fixed buffers and written straight to the next OTA
+// partition. Progress is stored in NVS after every verified chunk, so a
+// dropped transfer resumes from the last good chunk.
+//
+// The header is signed with HMAC-SHA256 over a fresh nonce, keyed with the
+// secret passed to setupOTAStream(), and checked before anything is written.
+// It carries the SHA-256 of the image, so the chunks are authenticated by the
+// check of the whole image before the boot partition is switched.
+//
+// Protocol (all integers little endian):
+//   device: 16 byte nonce
+//   client: "WCO2", u32 image size, u32 base size, u32 base crc32, 32 byte image sha256,
+//           32 byte HMAC-SHA256(secret, nonce + the 48 bytes before it)
+//   device: u32 index of the next chunk it needs
+//   client: per chunk u32 index, u8 flags, u16 data length, u32 crc32 of the decoded chunk, data
+//   device: u32 index of the next chunk it needs
+// The device answers OTA_STREAM_ERROR instead of an index when something is
+// wrong. After the last chunk the whole image is verified, the boot partition
+// is switched and the device restarts.
+
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include <WiFi.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <rom/miniz.h>
+#include <rom/crc.h>
+#include <mbedtls/md.h>
+
+const int OTA_STREAM_PORT = 3233;
+const uint32_t OTA_STREAM_MAGIC = 0x324F4357; // "WCO2"
+const uint32_t OTA_STREAM_ERROR = 0xFFFFFFFF;
+const uint32_t OTA_STREAM_DONE = 0xFFFFFFFE;
+const size_t OTA_CHUNK_SIZE = 4096; // flash sector size
+const unsigned long OTA_STREAM_TIMEOUT_MS = 10000;
+const size_t OTA_NONCE_SIZE = 16;
+const size_t OTA_SHA256_SIZE = 32;
+const size_t OTA_HEADER_SIZE = 16 + OTA_SHA256_SIZE; // without the HMAC
+
+const uint8_t OTA_CHUNK_DEFLATED = 0x01;
+const uint8_t OTA_CHUNK_DELTA = 0x02; // xor'd with the running image
+
+WiFiServer otaStreamServer(OTA_STREAM_PORT);
+Preferences otaStreamPrefs;
+
+uint8_t otaInBuffer[OTA_CHUNK_SIZE];
+uint8_t otaOutBuffer[OTA_CHUNK_SIZE];
+tinfl_decompressor otaInflator;
+const char* otaStreamSecret = "";
+
+boolean otaReadExact(WiFiClient& client, uint8_t* buffer, size_t length) {
+  unsigned long startMs = millis();
+  size_t received = 0;
+
+  while (received < length) {
+    if (!client.connected() || millis() - startMs > OTA_STREAM_TIMEOUT_MS) {
+      return false;
+    }
+    int available = client.available();
+    if (available <= 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    int read = client.read(buffer + received, min((size_t) available, length - received));
+    if (read > 0) {
+      received += read;
+      startMs = millis();
+    }
+  }
+  return true;
+}
+
+uint32_t otaReadU32(const uint8_t* buffer) {
+  return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+}
+
+void otaReply(WiFiClient& client, uint32_t value) {
+  uint8_t reply[4] = { (uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+  client.write(reply, sizeof(reply));
+}
+
+size_t otaInflate(const uint8_t* in, size_t inLength, uint8_t* out, size_t outLength) {
+  tinfl_init(&otaInflator);
+  size_t inBytes = inLength;
+  size_t outBytes = outLength;
+  tinfl_status status = tinfl_decompress(&otaInflator, in, &inBytes, out, out, &outBytes,
+                                         TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  return (status == TINFL_STATUS_DONE) ? outBytes : 0;
+}
+
+// HMAC-SHA256 of the nonce and the header, keyed with the OTA secret
+boolean otaHeaderSigned(const uint8_t* nonce, const uint8_t* header, const uint8_t* hmac) {
+  uint8_t signedData[OTA_NONCE_SIZE + OTA_HEADER_SIZE];
+  memcpy(signedData, nonce, OTA_NONCE_SIZE);
+  memcpy(signedData + OTA_NONCE_SIZE, header, OTA_HEADER_SIZE);
+
+  uint8_t expected[OTA_SHA256_SIZE];
+  if (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*) otaStreamSecret,
+                      strlen(otaStreamSecret), signedData, sizeof(signedData), expected) != 0) {
+    return false;
+  }
+
+  // compare in constant time so the HMAC cannot be guessed byte by byte
+  uint8_t difference = 0;
+  for (size_t i = 0; i < OTA_SHA256_SIZE; i++) {
+    difference |= expected[i] ^ hmac[i];
+  }
+  return difference == 0;
+}
+
+// SHA-256 over the first length bytes of a partition, read through otaInBuffer
+boolean otaPartitionSha256(const esp_partition_t* partition, size_t length, uint8_t* sha256) {
+  mbedtls_md_context_t context;
+  mbedtls_md_init(&context);
+  boolean ok = mbedtls_md_setup(&context, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) == 0
+            && mbedtls_md_starts(&context) == 0;
+
+  for (size_t offset = 0; ok && offset < length; offset += OTA_CHUNK_SIZE) {
+    size_t blockLength = min(OTA_CHUNK_SIZE, length - offset);
+    ok = esp_partition_read(partition, offset, otaInBuffer, blockLength) == ESP_OK
+      && mbedtls_md_update(&context, otaInBuffer, blockLength) == 0;
+  }
+  ok = ok && mbedtls_md_finish(&context, sha256) == 0;
+
+  mbedtls_md_free(&context);
+  return ok;
+}
+
+// crc32 over the first length bytes of a partition, read through otaInBuffer
+uint32_t otaPartitionCrc(const esp_partition_t* partition, size_t length) {
+  uint32_t crc = 0;
+  for (size_t offset = 0; offset < length; offset += OTA_CHUNK_SIZE) {
+    size_t blockLength = min(OTA_CHUNK_SIZE, length - offset);
+    if (esp_partition_read(partition, offset, otaInBuffer, blockLength) != ESP_OK) {
+      return 0;
+    }
+    crc = crc32_le(crc, otaInBuffer, blockLength);
+  }
+  return crc;
+}
+
+// Decode, verify and flash one chunk. Returns false if the chunk is rejected.
+boolean otaReceiveChunk(WiFiClient& client, const esp_partition_t* target, const esp_partition_t* running,
+                        uint32_t imageSize, uint32_t expectedIndex) {
+  uint8_t header[11];
+  if (!otaReadExact(client, header, sizeof(header))) {
+    return false;
+  }
+  uint32_t index = otaReadU32(header);
+  uint8_t flags = header[4];
+  size_t dataLength = header[5] | (header[6] << 8);
+  uint32_t crc = otaReadU32(header + 7);
+
+  size_t offset = index * OTA_CHUNK_SIZE;
+  size_t chunkLength = min(OTA_CHUNK_SIZE, (size_t) imageSize - offset);
+
+  if (index != expectedIndex || dataLength > OTA_CHUNK_SIZE) {
+    TelnetStream.print("[ERROR] OTA unexpected chunk ");
+    TelnetStream.println(index, DEC);
+    return false;
+  }
+  if (!otaReadExact(client, otaInBuffer, dataLength)) {
+    return false;
+  }
+
+  if (flags & OTA_CHUNK_DEFLATED) {
+    if (otaInflate(otaInBuffer, dataLength, otaOutBuffer, chunkLength) != chunkLength) {
+      TelnetStream.println("[ERROR] OTA chunk does not inflate");
+      return false;
+    }
+  } else if (dataLength == chunkLength) {
+    memcpy(otaOutBuffer, otaInBuffer, chunkLength);
+  } else {
+    return false;
+  }
+
+  if (flags & OTA_CHUNK_DELTA) {
+    if (esp_partition_read(running, offset, otaInBuffer, chunkLength) != ESP_OK) {
+      return false;
+    }
+    for (size_t i = 0; i < chunkLength; i++) {
+      otaOutBuffer[i] ^= otaInBuffer[i];
+    }
+  }
+
+  if (crc32_le(0, otaOutBuffer, chunkLength) != crc) {
+    TelnetStream.println("[ERROR] OTA chunk crc mismatch");
+    return false;
+  }
+
+  return esp_partition_erase_range(target, offset, OTA_CHUNK_SIZE) == ESP_OK
+      && esp_partition_write(target, offset, otaOutBuffer, chunkLength) == ESP_OK;
+}
+
+void otaHandleClient(WiFiClient& client) {
+  uint8_t nonce[OTA_NONCE_SIZE];
+  for (size_t i = 0; i < OTA_NONCE_SIZE; i += 4) {
+    uint32_t random = esp_random();
+    memcpy(nonce + i, &random, 4);
+  }
+  client.write(nonce, sizeof(nonce));
+
+  uint8_t header[OTA_HEADER_SIZE];
+  uint8_t hmac[OTA_SHA256_SIZE];
+  if (!otaReadExact(client, header, sizeof(header)) || otaReadU32(header) != OTA_STREAM_MAGIC
+      || !otaReadExact(client, hmac, sizeof(hmac))) {
+    TelnetStream.println("[ERROR] OTA invalid header");
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+  if (!otaHeaderSigned(nonce, header, hmac)) {
+    TelnetStream.println("[ERROR] OTA header is not signed with the OTA secret");
+    delay(1000); // slow down guessing
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+  uint32_t imageSize = otaReadU32(header + 4);
+  uint32_t baseSize = otaReadU32(header + 8);
+  uint32_t baseCrc = otaReadU32(header + 12);
+  const uint8_t* imageSha256 = header + 16;
+
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* target = esp_ota_get_next_update_partition(NULL);
+  if (target == NULL || imageSize == 0 || imageSize > target->size) {
+    TelnetStream.println("[ERROR] OTA image does not fit");
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+  if (baseSize > 0 && (baseSize > running->size || otaPartitionCrc(running, baseSize) != baseCrc)) {
+    TelnetStream.println("[ERROR] OTA delta base is not the running image");
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+
+  // resume if the same image was already partially written to the same partition
+  uint32_t numChunks = (imageSize + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+  uint32_t nextChunk = 0;
+  uint8_t storedSha256[OTA_SHA256_SIZE];
+  if (otaStreamPrefs.getBytes("sha256", storedSha256, sizeof(storedSha256)) == sizeof(storedSha256)
+      && memcmp(storedSha256, imageSha256, OTA_SHA256_SIZE) == 0
+      && otaStreamPrefs.getUInt("size") == imageSize && otaStreamPrefs.getUInt("part") == target->address) {
+    nextChunk = min(otaStreamPrefs.getUInt("next"), numChunks);
+  } else {
+    otaStreamPrefs.putBytes("sha256", imageSha256, OTA_SHA256_SIZE);
+    otaStreamPrefs.putUInt("size", imageSize);
+    otaStreamPrefs.putUInt("part", target->address);
+    otaStreamPrefs.putUInt("next", 0);
+  }
+
+  TelnetStream.printf("[INFO] OTA receiving %u bytes, resuming at chunk %u of %u\n", imageSize, nextChunk, numChunks);
+  otaReply(client, nextChunk);
+
+  while (nextChunk < numChunks) {
+    if (!otaReceiveChunk(client, target, running, imageSize, nextChunk)) {
+      TelnetStream.print("[ERROR] OTA transfer stopped at chunk ");
+      TelnetStream.println(nextChunk, DEC);
+      otaReply(client, OTA_STREAM_ERROR);
+      return;
+    }
+    nextChunk++;
+    otaStreamPrefs.putUInt("next", nextChunk);
+    otaReply(client, nextChunk);
+  }
+
+  uint8_t writtenSha256[OTA_SHA256_SIZE];
+  if (!otaPartitionSha256(target, imageSize, writtenSha256)
+      || memcmp(writtenSha256, imageSha256, OTA_SHA256_SIZE) != 0) {
+    TelnetStream.println("[ERROR] OTA image sha256 mismatch, starting over");
+    otaStreamPrefs.putUInt("next", 0);
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+  if (esp_ota_set_boot_partition(target) != ESP_OK) {
+    TelnetStream.println("[ERROR] OTA image is not bootable");
+    otaStreamPrefs.putUInt("next", 0);
+    otaReply(client, OTA_STREAM_ERROR);
+    return;
+  }
+
+  otaStreamPrefs.clear();
+  otaReply(client, OTA_STREAM_DONE);
+  client.stop();
+  TelnetStream.println("[INFO] OTA done, restarting.");
+  delay(500);
+  ESP.restart();
+}
+
+void otaStreamTask(void* parameter) {
+  for (;;) {
+    WiFiClient client = otaStreamServer.available();
+    if (client) {
+      client.setNoDelay(true);
+      otaHandleClient(client);
+      client.stop();
+    }
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+  }
+}
+
+void setupOTAStream(const char* secret) {
+  otaStreamSecret = secret;
+  otaStreamPrefs.begin("otastream", false);
+  otaStreamServer.begin();
+  xTaskCreate(otaStreamTask, "OTA_STREAM", 4096, NULL, 1, NULL);
+}
+
+#endif
@@ -0,0 +1,30 @@
+// Checks of the host programs
+//
+// expect() prints every check that does not hold and counts it. A program
+// ends with return checksPassed("name"), which prints the outcome and gives
+// the exit status make check looks at.
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+inline int failures = 0;
+
+inline void expect(bool condition, const char* what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+inline int checksPassed(const char* name) {
+  if (failures > 0) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("%s: all checks passed\n", name);
+  return 0;
+}
+
+#endif
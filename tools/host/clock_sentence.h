@@ -0,0 +1,87 @@
+// The sentence wordclock.c should show for a time, and the check of
+// composeTime() against it. Included by clock_verify.cpp inside the namespace
+// of each sketch configuration, so the names below are that configuration's.
+
+const char* const HOUR_NAMES[NUM_HOURS + 1] = {
+  "", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten", "eleven", "twelve"
+};
+
+Word word(const char* name, const int table[3]) {
+  return { name, "", table[0], table[1], table[2] };
+}
+
+// [it is] hour oclock for the first five minutes, then
+// [it is] five|ten|quarter|twenty|twenty five|half past|to hour
+Sentence sentence(int hour, int minute) {
+  Sentence words;
+  if (DISPLAY_IT_IS) {
+    words.push_back(word("it", w_it));
+    words.push_back(word("is", w_is));
+  }
+
+  // minutes from or to the hour, in steps of five
+  int fromHour = (minute < 35) ? (minute / 5) * 5 : 60 - (minute / 5) * 5;
+  if (fromHour == 20 || fromHour == 25) {
+    words.push_back(word("twenty", w_twenty));
+  }
+  if (fromHour == 5 || fromHour == 25) {
+    words.push_back(word("five", w_five));
+  } else if (fromHour == 10) {
+    words.push_back(word("ten", w_ten));
+  } else if (fromHour == 15) {
+    words.push_back(word("quarter", w_quarter));
+  } else if (fromHour == 30) {
+    words.push_back(word("half", w_half));
+  }
+  if (minute >= 5) {
+    words.push_back((minute < 35) ? word("past", w_past) : word("to", w_to));
+  }
+
+  int hourShown = ((minute < 35) ? hour : hour + 1) % 12;
+  hourShown = (hourShown == 0) ? 12 : hourShown;
+  words.push_back(word(HOUR_NAMES[hourShown], w_hours[hourShown]));
+  if (minute < 5) {
+    words.push_back(word("oclock", w_oclock));
+  }
+  return words;
+}
+
+// Compose every minute of the day with the fine minute LEDs in the given
+// order and compare leds_buffer with the sentence plus minute % 5 fine minute
+// LEDs, taken from the front of the order.
+void verifyDay(const int order[NUM_MINUTES], Report& report) {
+  buildLedMap();
+  boolean expected[NUM_LEDS];
+
+  for (int hour = 0; hour < 24; hour++) {
+    for (int minute = 0; minute < 60; minute++) {
+      memcpy(minuteOrder, order, sizeof(minuteOrder));
+      invalidWordLeds = 0;
+      composeTime(hour, minute);
+
+      Sentence words = sentence(hour, minute);
+      const char* problem = sentenceProblem(words, NUM_ROWS, NUM_COLS);
+      memset(expected, 0, sizeof(expected));
+      for (const Word& shown : words) {
+        for (int i = 0; i < shown.length; i++) {
+          int ledNum = convertFrom2DTo1D(shown.row, shown.col + i);
+          if (ledNum >= 0) {
+            expected[ledNum] = true;
+          }
+        }
+      }
+      for (int i = 0; i < minute % 5; i++) {
+        expected[convertFrom2DTo1D(w_minutes[order[i]][0], w_minutes[order[i]][1])] = true;
+      }
+
+      if (problem == NULL && invalidWordLeds > 0) {
+        problem = "a word runs off the grid";
+      }
+      if (problem == NULL && memcmp(expected, leds_buffer, sizeof(expected)) != 0) {
+        problem = "composeTime() lit other LEDs than the sentence";
+      }
+      report.check(hour, minute, words, problem);
+      frameClear(frame);
+    }
+  }
+}
@@ -0,0 +1,302 @@
+// Clock word check
+//
+// Composes every minute of the day with composeTime() and compares the LEDs
+// set in leds_buffer with the sentence the time should read (clock_sentence.h),
+// for every configuration of wordclock.c: with and without "IT IS", and with
+// the fine minute LEDs in every order. The words of each sentence must also
+// stay on the grid, read left to right and top to bottom, and not share LEDs.
+//
+// Word tables given on the command line are checked the same way against the
+// rules of "wordclock (fine).c": a 14x14 grid, w_minutes[] from one to
+// nineteen with quarter at 14 and twenty at 19, w_hours[] from one to eleven,
+// and noon and midnight instead of twelve. make check passes that file and a
+// layout tools/layout_search.cpp finds for tools/layouts/wordclock_fine.txt.
+//
+// The configurations are cut into tasks that worker threads take from a
+// shared queue, like tools/layout_search.cpp. Every thread has its own copy
+// of the sketch's variables (sketch.py --thread-local).
+//
+//   make -C tools/host check   (or build/clock_verify [--threads N] [TABLES...])
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// A word of a sentence. label is the word a table file names in a comment or
+// strlen(), empty if it names none.
+struct Word {
+  std::string name;
+  std::string label;
+  int row;
+  int col;
+  int length;
+};
+typedef std::vector<Word> Sentence;
+
+// Returns the first problem with the words of a sentence, or NULL
+const char* sentenceProblem(const Sentence& words, int rows, int cols) {
+  int lastCell = -1;
+  for (const Word& word : words) {
+    if (word.length <= 0) {
+      return "a word is missing from the tables";
+    }
+    if (!word.label.empty() && word.label != word.name) {
+      return "a table entry holds another word";
+    }
+    if (word.length != (int) word.name.size()) {
+      return "a word has the wrong length";
+    }
+    if (word.row < 0 || word.row >= rows || word.col < 0 || word.col + word.length > cols) {
+      return "a word runs off the grid";
+    }
+    int firstCell = word.row * cols + word.col;
+    if (firstCell <= lastCell) {
+      return "words are out of reading order or share LEDs";
+    }
+    lastCell = firstCell + word.length - 1;
+  }
+  return NULL;
+}
+
+// Cases and failures of one configuration; the first few failures are kept
+// to print
+class Report {
+public:
+  static const size_t MAX_EXAMPLES = 10;
+
+  std::string name;
+  std::atomic<long> cases;
+  std::atomic<long> failures;
+
+  Report(const std::string& name) : name(name), cases(0), failures(0) {}
+
+  void check(int hour, int minute, const Sentence& words, const char* problem) {
+    cases++;
+    if (problem == NULL) {
+      return;
+    }
+    failures++;
+
+    char time[8];
+    snprintf(time, sizeof(time), "%02d:%02d", hour, minute);
+    std::string example = std::string(time) + " \"";
+    for (size_t i = 0; i < words.size(); i++) {
+      example += (i > 0 ? " " : "") + words[i].name;
+    }
+    example += "\": " + std::string(problem);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (examples.size() < MAX_EXAMPLES) {
+      examples.push_back(example);
+    }
+  }
+
+  void print() {
+    printf("%-34s %7ld cases %5ld failures\n", name.c_str(), cases.load(), failures.load());
+    std::sort(examples.begin(), examples.end());
+    for (const std::string& example : examples) {
+      printf("  FAIL: %s\n", example.c_str());
+    }
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<std::string> examples;
+};
+
+namespace plain {
+#include "sketch_threads.inc"
+#include "clock_sentence.h"
+}
+
+namespace itIs {
+#include "sketch_threads_it_is.inc"
+#include "clock_sentence.h"
+}
+
+// Word tables of a file in the format of wordclock.c: "const int w_it[3] =
+// { 0, 0, 2 };" for single words and "const int w_hours[12][3] = { ... };"
+// for arrays, one "{ row, col, length }" per entry. The length may be written
+// as strlen("word"), as tools/layout_search.cpp prints it, otherwise a
+// comment after the entry names the word.
+typedef std::map<std::string, std::vector<Word> > Tables;
+
+bool readTables(const char* path, Tables& tables) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string source = contents.str();
+
+  std::regex declaration("const\\s+int\\s+w_(\\w+)\\s*(\\[\\w*\\])?\\s*\\[3\\]\\s*=([^;]*);");
+  std::regex entry("\\{\\s*(-?\\d+)\\s*,\\s*(-?\\d+)\\s*,\\s*(?:(-?\\d+)|strlen\\(\"(\\w+)\"\\))\\s*\\}"
+                   "[ \\t,]*(?://[ \\t]*(\\w+))?");
+  for (std::sregex_iterator table(source.begin(), source.end(), declaration), end; table != end; ++table) {
+    std::vector<Word>& words = tables[(*table)[1]];
+    std::string body = (*table)[3];
+    for (std::sregex_iterator match(body.begin(), body.end(), entry); match != end; ++match) {
+      Word word;
+      word.row = stoi((*match)[1]);
+      word.col = stoi((*match)[2]);
+      word.label = (*match)[4].matched ? (*match)[4].str() : (*match)[5].str();
+      word.length = (*match)[3].matched ? stoi((*match)[3]) : word.label.size();
+      words.push_back(word);
+    }
+  }
+  return true;
+}
+
+namespace fine {
+  const int NUM_ROWS = 14;
+  const int NUM_COLS = 14;
+  const char* const NUMBERS[] = {
+    "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten", "eleven", "twelve",
+    "thirteen", "fourteen", "quarter", "sixteen", "seventeen", "eighteen", "nineteen", "twenty"
+  };
+
+  // Entry index of table name, expected to hold the given word
+  Word tableWord(const Tables& tables, const std::string& name, size_t index, const char* expected) {
+    Word word = { expected, "", -1, -1, 0 };
+    auto table = tables.find(name);
+    if (table != tables.end() && index < table->second.size()) {
+      word = table->second[index];
+      word.name = expected;
+    }
+    return word;
+  }
+
+  Word tableWord(const Tables& tables, const char* name) {
+    return tableWord(tables, name, 0, name);
+  }
+
+  // showTime() of "wordclock (fine).c":
+  // it is [twenty] one..nineteen|quarter|half past|to hour|noon|midnight, or
+  // it is hour oclock|noon|midnight on the hour
+  Sentence sentence(const Tables& tables, int hour, int minute) {
+    Sentence words = { tableWord(tables, "it"), tableWord(tables, "is") };
+    int hourToDisplay = hour;
+
+    if (minute > 0) {
+      int fromHour = (minute <= 30) ? minute : 60 - minute;
+      if (fromHour > 20 && fromHour < 30) {
+        words.push_back(tableWord(tables, "minutes", 19, NUMBERS[19]));
+        fromHour -= 20;
+      }
+      if (fromHour == 30) {
+        words.push_back(tableWord(tables, "half"));
+      } else {
+        words.push_back(tableWord(tables, "minutes", fromHour - 1, NUMBERS[fromHour - 1]));
+      }
+
+      if (minute <= 30) {
+        words.push_back(tableWord(tables, "past"));
+      } else {
+        words.push_back(tableWord(tables, "to"));
+        hourToDisplay++;
+      }
+    }
+
+    hourToDisplay %= 24;
+    if (hourToDisplay == 0) {
+      words.push_back(tableWord(tables, "midnight"));
+    } else if (hourToDisplay == 12) {
+      words.push_back(tableWord(tables, "noon"));
+    } else {
+      int index = (hourToDisplay % 12) - 1;
+      words.push_back(tableWord(tables, "hours", index, NUMBERS[index]));
+      if (minute == 0) {
+        words.push_back(tableWord(tables, "oclock"));
+      }
+    }
+    return words;
+  }
+
+  void verifyDay(const Tables& tables, Report& report) {
+    for (int hour = 0; hour < 24; hour++) {
+      for (int minute = 0; minute < 60; minute++) {
+        Sentence words = sentence(tables, hour, minute);
+        report.check(hour, minute, words, sentenceProblem(words, NUM_ROWS, NUM_COLS));
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<const char*> tableFiles;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "usage: %s [--threads N] [TABLES...]\n", argv[0]);
+      return 1;
+    } else {
+      tableFiles.push_back(argv[i]);
+    }
+  }
+
+  std::deque<Report> reports;
+  std::vector<std::function<void()> > tasks;
+
+  // one task per fine minute order of each configuration
+  Report& plainReport = reports.emplace_back("wordclock.c");
+  Report& itIsReport = reports.emplace_back("wordclock.c, DISPLAY_IT_IS");
+  std::vector<int> order(plain::NUM_MINUTES);
+  for (int i = 0; i < plain::NUM_MINUTES; i++) {
+    order[i] = i;
+  }
+  do {
+    tasks.push_back([order, &plainReport] { plain::verifyDay(order.data(), plainReport); });
+    tasks.push_back([order, &itIsReport] { itIs::verifyDay(order.data(), itIsReport); });
+  } while (std::next_permutation(order.begin(), order.end()));
+
+  std::deque<Tables> tables;
+  for (const char* path : tableFiles) {
+    Tables& fileTables = tables.emplace_back();
+    if (!readTables(path, fileTables)) {
+      fprintf(stderr, "cannot read %s\n", path);
+      return 1;
+    }
+    Report& report = reports.emplace_back(path);
+    tasks.push_back([&fileTables, &report] { fine::verifyDay(fileTables, report); });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> nextTask(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&]() {
+      for (size_t task = nextTask++; task < tasks.size(); task = nextTask++) {
+        tasks[task]();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  long cases = 0;
+  long failures = 0;
+  for (Report& report : reports) {
+    report.print();
+    cases += report.cases;
+    failures += report.failures;
+  }
+  printf("%ld cases, %ld failures, %d threads, %zu tasks in %.3f s (%.0f cases/s)\n",
+         cases, failures, threads, tasks.size(), elapsed, cases / std::max(elapsed, 1e-9));
+  return failures > 0 ? 1 : 0;
+}
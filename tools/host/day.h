@@ -0,0 +1,65 @@
+// A scripted day for host simulations
+//
+// Someone gets up at 6:45, is out from 8:15 to 17:30 apart from lunch at
+// home, and goes to bed at 22:45. While someone is home the PIR sensor sees
+// them for a few seconds every couple of minutes. The light sensor follows
+// daylight, with a lamp on in the evening.
+
+#ifndef HOST_DAY_H
+#define HOST_DAY_H
+
+#include <Arduino.h>
+
+namespace day {
+  const unsigned long SECONDS = 24UL * 60 * 60;
+
+  struct Span {
+    unsigned long start;
+    unsigned long end;
+  };
+
+  const Span HOME[] = {
+    { ( 6 * 60 + 45) * 60, ( 8 * 60 + 15) * 60 },
+    { (12 * 60 + 10) * 60, (12 * 60 + 50) * 60 },
+    { (17 * 60 + 30) * 60, (22 * 60 + 45) * 60 }
+  };
+
+  inline bool home(unsigned long s) {
+    s %= SECONDS;
+    for (const Span& span : HOME) {
+      if (s >= span.start && s < span.end) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // PIR output: high for 4 to 9 s out of every 97 to 180 s while someone is home
+  inline int motion(unsigned long s) {
+    if (!home(s)) {
+      return LOW;
+    }
+    unsigned long period = 97 + (s / 600) % 84;
+    return (s % period) < 4 + (s / 3600) % 6 ? HIGH : LOW;
+  }
+
+  // LDR reading, 0 to 4095
+  inline int light(unsigned long s) {
+    double hours = (s % SECONDS) / 3600.0;
+    double daylight = sin((hours - 6.5) / 13.0 * M_PI); // up from 6:30 to 19:30
+    int reading = (daylight > 0) ? 200 + (int) (2800 * daylight) : 60;
+    if (home(s) && hours > 18) {
+      reading = max(reading, 700); // lamp
+    }
+    return reading;
+  }
+
+  // Set the sensor pins for second s of the day; the PIR pin fires the
+  // interrupt handler attached to it
+  inline void drive(unsigned long s, uint8_t pinMotion, uint8_t pinLight) {
+    host::analogLevels[pinLight] = light(s);
+    host::setPin(pinMotion, motion(s));
+  }
+}
+
+#endif
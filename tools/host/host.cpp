@@ -0,0 +1,587 @@
+// Definitions behind the host stand-ins in stubs/
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "Arduino.h"
+#include "FastLED.h"
+#include "WiFi.h"
+#include "ezTime.h"
+#include "OTATelnetStream.h"
+#include "Preferences.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/md.h"
+#include "rom/crc.h"
+#include "rom/miniz.h"
+
+HardwareSerial Serial;
+CFastLED FastLED;
+WiFiClass WiFi;
+Timezone UTC;
+TelnetStreamClass TelnetStream;
+EspClass ESP;
+
+namespace host {
+  unsigned long long nowUs = 0;
+  bool realTime = false;
+  int pinLevels[64];
+  int analogLevels[64];
+  bool runTasks = false;
+  void (*onRestart)() = NULL;
+  uint32_t cpuMhz = 240;
+  unsigned long clockStartS = 0;
+  unsigned long timeEvents = 0;
+  bool echoLog = false;
+  bool captureLog = false;
+  std::string logCapture;
+  bool network = false;
+
+  void (*interrupts[64])();
+
+  void advance(unsigned long long us) {
+    nowUs += us;
+  }
+
+  void setPin(uint8_t pin, int level) {
+    if (pinLevels[pin] == level) {
+      return;
+    }
+    pinLevels[pin] = level;
+    if (interrupts[pin] != NULL) {
+      interrupts[pin]();
+    }
+  }
+
+  unsigned long long wallUs() {
+    static auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+unsigned long micros() {
+  return host::realTime ? host::wallUs() : host::nowUs;
+}
+
+void delay(unsigned long ms) {
+  if (host::realTime) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  } else {
+    host::advance(ms * 1000ULL);
+  }
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+int digitalRead(uint8_t pin) {
+  return host::pinLevels[pin];
+}
+
+int analogRead(uint8_t pin) {
+  return host::analogLevels[pin];
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+  return pin;
+}
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode) {
+  host::interrupts[interrupt] = isr;
+}
+
+void setCpuFrequencyMhz(uint32_t mhz) {
+  host::cpuMhz = mhz;
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return host::cpuMhz;
+}
+
+uint32_t esp_random() {
+  return (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+}
+
+void vTaskDelay(uint32_t ticks) {
+  delay(ticks * portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskCreate(void (*task)(void*), const char* name, uint32_t stackDepth, void* parameter,
+                       int priority, TaskHandle_t* handle) {
+  if (host::runTasks) {
+    std::thread(task, parameter).detach();
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackDepth, void* parameter,
+                                   int priority, TaskHandle_t* handle, int core) {
+  return xTaskCreate(task, name, stackDepth, parameter, priority, handle);
+}
+
+void EspClass::restart() {
+  if (host::onRestart == NULL) {
+    fprintf(stderr, "ESP.restart() called\n");
+    exit(1);
+  }
+  host::onRestart();
+}
+
+// ezTime
+int hour() {
+  return ((host::clockStartS + millis() / 1000) / 3600) % 24;
+}
+
+int minute() {
+  return ((host::clockStartS + millis() / 1000) / 60) % 60;
+}
+
+int second() {
+  return (host::clockStartS + millis() / 1000) % 60;
+}
+
+void events() {
+  host::timeEvents++;
+}
+
+bool waitForSync(uint16_t timeout) {
+  return true;
+}
+
+void setInterval(uint16_t seconds) {}
+
+String Timezone::dateTime() {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hour(), minute(), second());
+  return String(buffer);
+}
+
+// TelnetStream
+size_t TelnetStreamClass::write(const uint8_t* buffer, size_t size) {
+  bytes += size;
+  if (host::echoLog) {
+    fwrite(buffer, 1, size, stdout);
+  }
+  if (host::captureLog) {
+    host::logCapture.append((const char*) buffer, size);
+  }
+  return size;
+}
+
+// Preferences, one map for all namespaces
+static std::map<std::string, std::vector<uint8_t>> preferences;
+static std::mutex preferencesMutex;
+
+bool Preferences::clear() {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  std::string prefix = space + "/";
+  for (auto it = preferences.begin(); it != preferences.end();) {
+    it = (it->first.compare(0, prefix.size(), prefix) == 0) ? preferences.erase(it) : std::next(it);
+  }
+  return true;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  auto it = preferences.find(space + "/" + key);
+  return (it == preferences.end()) ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  auto it = preferences.find(space + "/" + key);
+  if (it == preferences.end() || it->second.size() > length) {
+    return 0;
+  }
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::putBytes(const char* key, const void* buffer, size_t length) {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  const uint8_t* bytes = (const uint8_t*) buffer;
+  preferences[space + "/" + key].assign(bytes, bytes + length);
+  return length;
+}
+
+// WiFi sockets
+struct HostSocket {
+  int fd;
+  ~HostSocket() { close(fd); }
+};
+
+WiFiClient::WiFiClient(int fd) : socket(new HostSocket { fd }) {}
+
+WiFiClient::operator bool() {
+  return socket != NULL;
+}
+
+bool WiFiClient::connected() {
+  if (socket == NULL) {
+    return false;
+  }
+  uint8_t c;
+  ssize_t peeked = recv(socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return peeked > 0 || (peeked < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int WiFiClient::available() {
+  int bytes = 0;
+  if (socket == NULL || ioctl(socket->fd, FIONREAD, &bytes) != 0) {
+    return 0;
+  }
+  return bytes;
+}
+
+int WiFiClient::peek() {
+  uint8_t c;
+  return (socket != NULL && recv(socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) ? c : -1;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return (read(&c, 1) == 1) ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  if (socket == NULL) {
+    return -1;
+  }
+  ssize_t received = recv(socket->fd, buffer, size, MSG_DONTWAIT);
+  return (received > 0) ? received : -1;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  size_t sent = 0;
+  while (socket != NULL && sent < size) {
+    ssize_t n = send(socket->fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += n;
+  }
+  return sent;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int value = noDelay;
+  if (socket != NULL) {
+    setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+  }
+}
+
+void WiFiClient::stop() {
+  socket.reset();
+}
+
+void WiFiServer::begin() {
+  if (!host::network || listener >= 0) {
+    return;
+  }
+  listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(listener, (sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 4) != 0
+      || getsockname(listener, (sockaddr*) &address, &length) != 0) {
+    perror("WiFiServer::begin()");
+    exit(1);
+  }
+  fcntl(listener, F_SETFL, O_NONBLOCK);
+  boundPort = ntohs(address.sin_port);
+}
+
+WiFiClient WiFiServer::available() {
+  int fd = (listener >= 0) ? accept(listener, NULL, NULL) : -1;
+  return (fd >= 0) ? WiFiClient(fd) : WiFiClient();
+}
+
+// ESP-IDF flash partitions, in memory
+namespace host {
+  const esp_partition_t otaPartitions[2] = {
+    { 0x10000, 0x140000, "ota_0" },
+    { 0x150000, 0x140000, "ota_1" }
+  };
+  int runningPartition = 0;
+  const esp_partition_t* bootPartition = &otaPartitions[0];
+  unsigned long flashWrites = 0;
+
+  static std::vector<uint8_t> flash(0x290000, 0xFF);
+  static std::mutex flashMutex;
+
+  uint8_t* partitionData(const esp_partition_t* partition) {
+    return flash.data() + partition->address;
+  }
+
+  static bool inPartition(const esp_partition_t* partition, size_t offset, size_t size) {
+    return partition != NULL && offset <= partition->size && size <= partition->size - offset;
+  }
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* buffer, size_t size) {
+  if (!host::inPartition(partition, offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  std::lock_guard<std::mutex> lock(host::flashMutex);
+  memcpy(buffer, host::partitionData(partition) + offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* buffer, size_t size) {
+  if (!host::inPartition(partition, offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  std::lock_guard<std::mutex> lock(host::flashMutex);
+  uint8_t* data = host::partitionData(partition) + offset;
+  for (size_t i = 0; i < size; i++) {
+    data[i] &= ((const uint8_t*) buffer)[i];
+  }
+  host::flashWrites++;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  if (offset % host::FLASH_SECTOR_SIZE != 0 || size % host::FLASH_SECTOR_SIZE != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!host::inPartition(partition, offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  std::lock_guard<std::mutex> lock(host::flashMutex);
+  memset(host::partitionData(partition) + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+  return &host::otaPartitions[host::runningPartition];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start) {
+  return &host::otaPartitions[1 - host::runningPartition];
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+  if (partition != &host::otaPartitions[0] && partition != &host::otaPartitions[1]) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  host::bootPartition = partition;
+  return ESP_OK;
+}
+
+// mbedtls, SHA-256 as in FIPS 180-4
+struct mbedtls_md_info_t {
+  mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t sha256Info = { MBEDTLS_MD_SHA256 };
+
+static const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotateRight(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(uint32_t* state, const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t v[8];
+  memcpy(v, state, sizeof(v));
+  for (int i = 0; i < 64; i++) {
+    uint32_t s1 = rotateRight(v[4], 6) ^ rotateRight(v[4], 11) ^ rotateRight(v[4], 25);
+    uint32_t choose = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    uint32_t t1 = v[7] + s1 + choose + SHA256_K[i] + w[i];
+    uint32_t s0 = rotateRight(v[0], 2) ^ rotateRight(v[0], 13) ^ rotateRight(v[0], 22);
+    uint32_t majority = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    memmove(v + 1, v, 7 * sizeof(uint32_t));
+    v[4] += t1;
+    v[0] = t1 + s0 + majority;
+  }
+  for (int i = 0; i < 8; i++) {
+    state[i] += v[i];
+  }
+}
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+  return (type == MBEDTLS_MD_SHA256) ? &sha256Info : NULL;
+}
+
+void mbedtls_md_init(mbedtls_md_context_t* context) {
+  memset(context, 0, sizeof(*context));
+}
+
+void mbedtls_md_free(mbedtls_md_context_t* context) {
+  memset(context, 0, sizeof(*context));
+}
+
+int mbedtls_md_setup(mbedtls_md_context_t* context, const mbedtls_md_info_t* info, int hmac) {
+  if (info == NULL) {
+    return -1;
+  }
+  context->info = info;
+  return 0;
+}
+
+int mbedtls_md_starts(mbedtls_md_context_t* context) {
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  if (context->info == NULL) {
+    return -1;
+  }
+  memcpy(context->state, initial, sizeof(initial));
+  context->length = 0;
+  return 0;
+}
+
+int mbedtls_md_update(mbedtls_md_context_t* context, const unsigned char* input, size_t length) {
+  if (context->info == NULL) {
+    return -1;
+  }
+  while (length > 0) {
+    size_t used = context->length % 64;
+    size_t n = min(length, 64 - used);
+    memcpy(context->block + used, input, n);
+    context->length += n;
+    input += n;
+    length -= n;
+    if (used + n == 64) {
+      sha256Block(context->state, context->block);
+    }
+  }
+  return 0;
+}
+
+int mbedtls_md_finish(mbedtls_md_context_t* context, unsigned char* output) {
+  if (context->info == NULL) {
+    return -1;
+  }
+  uint64_t bits = context->length * 8;
+  uint8_t padding[72] = { 0x80 };
+  size_t paddingLength = 64 - (context->length + 8) % 64;
+  for (int i = 0; i < 8; i++) {
+    padding[paddingLength + i] = bits >> (56 - 8 * i);
+  }
+  mbedtls_md_update(context, padding, paddingLength + 8);
+  for (int i = 0; i < 32; i++) {
+    output[i] = context->state[i / 4] >> (24 - 8 * (i % 4));
+  }
+  return 0;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t keyLength,
+                    const unsigned char* input, size_t length, unsigned char* output) {
+  mbedtls_md_context_t context;
+  mbedtls_md_init(&context);
+  if (mbedtls_md_setup(&context, info, 1) != 0) {
+    return -1;
+  }
+
+  uint8_t blockKey[64] = {};
+  if (keyLength > sizeof(blockKey)) {
+    mbedtls_md_starts(&context);
+    mbedtls_md_update(&context, key, keyLength);
+    mbedtls_md_finish(&context, blockKey);
+  } else {
+    memcpy(blockKey, key, keyLength);
+  }
+  uint8_t pad[64];
+  uint8_t inner[32];
+
+  for (int i = 0; i < 64; i++) {
+    pad[i] = blockKey[i] ^ 0x36;
+  }
+  mbedtls_md_starts(&context);
+  mbedtls_md_update(&context, pad, sizeof(pad));
+  mbedtls_md_update(&context, input, length);
+  mbedtls_md_finish(&context, inner);
+
+  for (int i = 0; i < 64; i++) {
+    pad[i] = blockKey[i] ^ 0x5c;
+  }
+  mbedtls_md_starts(&context);
+  mbedtls_md_update(&context, pad, sizeof(pad));
+  mbedtls_md_update(&context, inner, sizeof(inner));
+  mbedtls_md_finish(&context, output);
+
+  mbedtls_md_free(&context);
+  return 0;
+}
+
+// The ROM inflater, raw deflate through zlib
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inSize, uint8_t* outStart,
+                              uint8_t* out, size_t* outSize, uint32_t flags) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    return TINFL_STATUS_FAILED;
+  }
+  stream.next_in = (Bytef*) in;
+  stream.avail_in = *inSize;
+  stream.next_out = out;
+  stream.avail_out = *outSize;
+  int result = inflate(&stream, Z_FINISH);
+  *inSize = stream.total_in;
+  *outSize = stream.total_out;
+  bool outputFull = stream.avail_out == 0;
+  inflateEnd(&stream);
+
+  if (result == Z_STREAM_END) {
+    return TINFL_STATUS_DONE;
+  }
+  if (result != Z_BUF_ERROR) {
+    return TINFL_STATUS_FAILED;
+  }
+  if (outputFull) {
+    return TINFL_STATUS_HAS_MORE_OUTPUT;
+  }
+  return (flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+}
+
+uint32_t crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc ^= *buffer++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
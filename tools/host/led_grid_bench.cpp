@@ -0,0 +1,186 @@
+// LED grid benchmark
+//
+// Checks that the sketch's tile table wires every grid position to its own
+// LED, that mapTiles() catches broken tables, and times mapTiles() and frame
+// updates over generated tile tables of 1k, 4k and 16k LEDs. A frame update
+// only touches LEDs that change, so it should cost the same at every size
+// while redrawing the whole strip grows with it.
+//
+//   make -C tools/host check   (or build/led_grid_bench)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "check.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace sketch {
+#include "sketch.inc"
+}
+
+double elapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Every LED below numLeds is wired to exactly one grid position
+bool isOneToOne(const int16_t* ledMap, int cells, int numLeds) {
+  std::vector<int> positions(numLeds, 0);
+  for (int i = 0; i < cells; i++) {
+    if (ledMap[i] >= 0) {
+      positions[ledMap[i]]++;
+    }
+  }
+  for (int count : positions) {
+    if (count != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void checkSketchTiles() {
+  expect(sketch::buildLedMap(), "sketch tile table maps without errors");
+  expect(isOneToOne(&sketch::ledMap[0][0], sketch::GRID_ROWS * sketch::NUM_COLS, sketch::NUM_LEDS),
+         "sketch tile table wires every LED once");
+}
+
+const char* brokenReason(std::vector<Tile> tiles, int rows, int cols, int numLeds) {
+  std::vector<int16_t> ledMap(rows * cols);
+  LedMapError error = {};
+  int errors = mapTiles(tiles.data(), tiles.size(), ledMap.data(), rows, cols, numLeds, &error);
+  return (errors > 0) ? error.reason : "";
+}
+
+void checkBrokenTiles() {
+  // two 4x4 tiles on an 4x8 grid, the second one shifted onto the first
+  std::vector<Tile> overlap = {
+    { 0, 0, 4, 4, 0,  true, false, false, false },
+    { 0, 2, 4, 4, 16, true, false, false, false }
+  };
+  expect(strcmp(brokenReason(overlap, 4, 8, 32), "tiles overlap") == 0, "overlapping tiles are reported");
+
+  // side by side, but the second tile starts at the same LED as the first
+  std::vector<Tile> sharedLeds = {
+    { 0, 0, 4, 4, 0, true, false, false, false },
+    { 0, 4, 4, 4, 0, true, false, false, false }
+  };
+  expect(strcmp(brokenReason(sharedLeds, 4, 8, 32), "LED wired to two grid positions") == 0,
+         "two tiles wired to the same LEDs are reported");
+
+  std::vector<Tile> outOfRange = {
+    { 0, 0, 4, 4, 0,  true, false, false, false },
+    { 0, 4, 4, 4, 20, true, false, false, false }
+  };
+  expect(strcmp(brokenReason(outOfRange, 4, 8, 32), "LED out of range") == 0, "LEDs past the strip are reported");
+
+  std::vector<Tile> offGrid = {
+    { 0, 6, 4, 4, 0, true, false, false, false }
+  };
+  expect(strcmp(brokenReason(offGrid, 4, 8, 32), "tile outside the grid") == 0, "tiles off the grid are reported");
+}
+
+// A square grid of chained 16x16 panels, each wired a little differently
+std::vector<Tile> generateTiles(int side) {
+  const int PANEL = 16;
+  std::vector<Tile> tiles;
+  for (int row = 0; row < side; row += PANEL) {
+    for (int col = 0; col < side; col += PANEL) {
+      int t = tiles.size();
+      tiles.push_back({ row, col, PANEL, PANEL, t * PANEL * PANEL,
+                        t % 2 == 0, t % 3 == 1, t % 4 == 2, t % 5 == 3 });
+    }
+  }
+  return tiles;
+}
+
+// Word clock like frames: a few dozen LEDs, a handful of which change between
+// frames
+std::vector<std::vector<int>> generateFrames(int numLeds, int numFrames) {
+  const int LIT = 30;
+  const int CHANGED = 4;
+  std::mt19937 random(numLeds);
+  std::uniform_int_distribution<int> led(0, numLeds - 1);
+
+  std::vector<std::vector<int>> frames;
+  std::vector<int> lit;
+  for (int i = 0; i < LIT; i++) {
+    lit.push_back(led(random));
+  }
+  for (int f = 0; f < numFrames; f++) {
+    for (int i = 0; i < CHANGED; i++) {
+      lit[(f * CHANGED + i) % LIT] = led(random);
+    }
+    frames.push_back(lit);
+  }
+  return frames;
+}
+
+void benchmark(int numLeds) {
+  const int MAP_RUNS = 20;
+  const int NUM_FRAMES = 20000;
+  int side = sqrt(numLeds);
+  std::vector<Tile> tiles = generateTiles(side);
+  std::vector<int16_t> ledMap(side * side);
+
+  auto start = std::chrono::steady_clock::now();
+  int errors = 0;
+  for (int i = 0; i < MAP_RUNS; i++) {
+    errors += mapTiles(tiles.data(), tiles.size(), ledMap.data(), side, side, numLeds, NULL);
+  }
+  double mapUs = elapsedNs(start) / MAP_RUNS / 1000;
+
+  char what[64];
+  snprintf(what, sizeof(what), "%d LED tile table maps without errors", numLeds);
+  expect(errors == 0 && isOneToOne(ledMap.data(), side * side, numLeds), what);
+
+  std::vector<CRGB> leds(numLeds);
+  std::vector<uint8_t> buffer(numLeds, 0);
+  std::vector<int16_t> lit(numLeds);
+  std::vector<int16_t> shown(numLeds);
+  std::vector<uint32_t> mask((numLeds + 31) / 32, 0);
+  LedFrame frame = { numLeds, leds.data(), (boolean*) buffer.data(), lit.data(), 0, shown.data(), 0, mask.data() };
+  std::vector<std::vector<int>> frames = generateFrames(numLeds, NUM_FRAMES);
+
+  // only the LEDs that change
+  int shows = 0;
+  start = std::chrono::steady_clock::now();
+  for (const std::vector<int>& f : frames) {
+    for (int ledNum : f) {
+      frameSetLed(frame, ledNum);
+    }
+    shows += frameUpdate(frame);
+  }
+  double frameNs = elapsedNs(start) / NUM_FRAMES;
+
+  // the whole strip, as every frame was drawn before
+  std::vector<uint8_t> fullBuffer(numLeds, 0);
+  start = std::chrono::steady_clock::now();
+  for (const std::vector<int>& f : frames) {
+    for (int ledNum : f) {
+      fullBuffer[ledNum] = true;
+    }
+    for (int i = 0; i < numLeds; i++) {
+      leds[i] = fullBuffer[i] ? CRGB::White : CRGB::Black;
+      fullBuffer[i] = false;
+    }
+  }
+  double fullNs = elapsedNs(start) / NUM_FRAMES;
+
+  printf("%6d LEDs  %4zu tiles  mapTiles %8.1f us  frame update %7.1f ns  full redraw %9.1f ns  (%d shows)\n",
+         numLeds, tiles.size(), mapUs, frameNs, fullNs, shows);
+
+  snprintf(what, sizeof(what), "%d LED frame update is cheaper than a full redraw", numLeds);
+  expect(numLeds < 4096 || frameNs * 10 < fullNs, what);
+}
+
+int main() {
+  checkSketchTiles();
+  checkBrokenTiles();
+
+  for (int numLeds : { 1024, 4096, 16384 }) {
+    benchmark(numLeds);
+  }
+
+  return checksPassed("LED grid");
+}
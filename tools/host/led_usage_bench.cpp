@@ -0,0 +1,156 @@
+// LED usage benchmark and wear balancing simulation
+//
+// Times accountLedUsage() per frame, which only visits the LEDs set in the
+// frame mask, against scanning every LED, and checks what both charge.
+//
+// Then runs the clock minute by minute through several years of the day in
+// day.h: the display is lit at the brightness the light sensor gives while
+// someone is home and dark otherwise. LED usage is saved to NVS once a day
+// and read back on a reboot once a month, as on the clock. The usage of the
+// fine minute LEDs has to stay within a small spread of each other, where
+// lighting them in a fixed order would wear the first one four times as fast
+// as the last.
+//
+//   make -C tools/host check   (or build/led_usage_bench)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "check.h"
+#include "day.h"
+#include <chrono>
+
+namespace sketch {
+#include "sketch.inc"
+}
+
+const int YEARS = 3;
+const double MAX_SPREAD = 0.005; // (max - min) / max of the fine minute LEDs
+
+// The accounting before the frame mask: every LED of the strip, every frame
+void accountEveryLed(uint64_t weight) {
+  for (int i = 0; i < sketch::NUM_LEDS; i++) {
+    if (sketch::leds[i] != CRGB(CRGB::Black)) {
+      sketch::ledUsage[i] += weight;
+    }
+  }
+}
+
+void resetUsage() {
+  memset(sketch::ledUsage, 0, sizeof(sketch::ledUsage));
+  sketch::litBrightnessMs = 0;
+  sketch::lastUsageMs = millis();
+}
+
+void benchmarkFrame(const char* name) {
+  const int FRAMES = 1000000;
+  const uint8_t BRIGHTNESS = 50;
+  frameUpdate(sketch::frame);
+  FastLED.setBrightness(BRIGHTNESS);
+  resetUsage();
+  sketch::lastUsageBrightness = BRIGHTNESS;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FRAMES; i++) {
+    host::advance(1000);
+    sketch::accountLedUsage();
+  }
+  double maskNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+
+  // each frame was shown for 1 ms at BRIGHTNESS
+  uint64_t expected = (uint64_t) FRAMES * BRIGHTNESS;
+  bool charged = true;
+  for (int i = 0; i < sketch::NUM_LEDS; i++) {
+    bool lit = sketch::leds[i] != CRGB(CRGB::Black);
+    charged &= sketch::ledUsage[i] == (lit ? expected : 0);
+  }
+  expect(charged, "accountLedUsage() charges lit LEDs for their time and brightness, and nothing else");
+  expect(sketch::litBrightnessMs == expected * sketch::frame.numShown, "the total is the sum over lit LEDs");
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FRAMES; i++) {
+    accountEveryLed(BRIGHTNESS);
+  }
+  double everyLedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+
+  printf("%-28s %3d of %d LEDs lit  frame mask %6.1f ns  every LED %6.1f ns per frame\n",
+         name, sketch::frame.numShown, sketch::NUM_LEDS, maskNs, everyLedNs);
+}
+
+uint64_t fineMinuteUsage(int i) {
+  return sketch::wordUsage(sketch::w_minutes[i]);
+}
+
+double fineMinuteSpread() {
+  uint64_t least = fineMinuteUsage(0);
+  uint64_t most = least;
+  for (int i = 1; i < sketch::NUM_MINUTES; i++) {
+    least = min(least, fineMinuteUsage(i));
+    most = max(most, fineMinuteUsage(i));
+  }
+  return (most > 0) ? (double) (most - least) / most : 0;
+}
+
+void simulateYears() {
+  resetUsage();
+  sketch::ledUsagePrefs.begin("ledusage", false);
+  sketch::ledUsagePrefs.clear();
+  FastLED.setBrightness(0);
+  sketch::lastUsageBrightness = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  double worstSpread = 0;
+  for (int year = 1; year <= YEARS; year++) {
+    for (int dayOfYear = 0; dayOfYear < 365; dayOfYear++) {
+      for (unsigned long s = 0; s < day::SECONDS; s += 60) {
+        // as setBrightness() would, without the fade
+        for (int i = 0; i < sketch::LIGHT_BUFFER_SIZE; i++) {
+          sketch::lightBuffer[i] = day::light(s);
+        }
+        FastLED.setBrightness(day::home(s) ? sketch::calculateBrightness() : 0);
+
+        sketch::composeTime(s / 3600, (s / 60) % 60);
+        sketch::updateDisplayAndClearBuffer();
+        host::advance(60000000ULL);
+      }
+
+      sketch::saveLedUsage();
+      if (dayOfYear % 30 == 29) {
+        // reboot: usage comes back from NVS in whole units
+        memset(sketch::ledUsage, 0, sizeof(sketch::ledUsage));
+        sketch::loadLedUsage();
+      }
+      if (year > 1 || dayOfYear >= 30) {
+        worstSpread = max(worstSpread, fineMinuteSpread());
+      }
+    }
+
+    printf("year %d: fine minute LEDs", year);
+    for (int i = 0; i < sketch::NUM_MINUTES; i++) {
+      printf(" %llu", (unsigned long long) (fineMinuteUsage(i) / sketch::USAGE_UNIT_MS));
+    }
+    printf(" (brightness x minutes), spread %.4f%%\n", 100 * fineMinuteSpread());
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%d simulated years in %.2f s, worst spread after the first month %.4f%%\n",
+         YEARS, elapsed, 100 * worstSpread);
+  expect(worstSpread <= MAX_SPREAD, "the fine minute LEDs wear evenly");
+}
+
+int main() {
+  sketch::buildLedMap();
+
+  sketch::composeTime(10, 37);
+  benchmarkFrame("twenty five to eleven + 2");
+
+  for (int i = 0; i < sketch::NUM_LEDS; i++) {
+    frameSetLed(sketch::frame, i);
+  }
+  benchmarkFrame("every LED lit");
+
+  frameClear(sketch::frame);
+  frameUpdate(sketch::frame);
+  simulateYears();
+
+  return checksPassed("LED usage");
+}
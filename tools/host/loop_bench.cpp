@@ -0,0 +1,129 @@
+// Whole day loop benchmark
+//
+// Runs setup() once, then loop() through the scripted day in day.h on the
+// virtual clock, with the light sensor following daylight and the PIR sensor
+// firing while someone is home. The stand-ins count what reaches the outside
+// world: show() calls and bytes sent to the strip (FastLED), bytes logged
+// (TelnetStream) and ezTime events() calls. The longest loop() is measured
+// on the virtual clock, so a fade that blocks the loop shows up, and the
+// host CPU time spent in loop() is measured on the real one.
+//
+// Every figure with a line in the threshold file is a limit for the day; the
+// run fails if one is exceeded.
+//
+//   make -C tools/host check   (or build/loop_bench loop_bench_thresholds.txt)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "day.h"
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace sketch {
+#include "sketch.inc"
+}
+
+const unsigned long long STEP_US = 10000; // one pass of an idle loop()
+
+struct Figure {
+  const char* name;
+  const char* unit;
+  double value;
+};
+
+// One "name limit" per line, # starts a comment
+bool readThresholds(const char* path, std::map<std::string, double>& limits) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string name;
+    double limit;
+    if (fields >> name >> limit) {
+      limits[name] = limit;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* thresholdsPath = (argc > 1) ? argv[1] : "loop_bench_thresholds.txt";
+  std::map<std::string, double> limits;
+  if (!readThresholds(thresholdsPath, limits)) {
+    fprintf(stderr, "cannot read %s\n", thresholdsPath);
+    return 1;
+  }
+
+  sketch::setup();
+
+  // count the day only, not booting
+  unsigned long shows = FastLED.shows;
+  unsigned long long stripBytes = FastLED.bytesSent;
+  unsigned long long logBytes = TelnetStream.bytes;
+  unsigned long timeEvents = host::timeEvents;
+
+  unsigned long loops = 0;
+  unsigned long maxLoopUs = 0;
+  unsigned long long busyUs = 0;
+  double cpuNs = 0;
+
+  unsigned long long endUs = host::nowUs + day::SECONDS * 1000000ULL;
+  while (host::nowUs < endUs) {
+    unsigned long long beforeUs = host::nowUs;
+    day::drive(millis() / 1000, sketch::PIN_MOTION, sketch::PIN_LIGHT);
+
+    // loopStats are reset once a day by the sketch, so take them per loop
+    unsigned long long busyBeforeUs = sketch::loopStats.busyUs;
+    sketch::loopStats.maxLoopUs = 0;
+    auto start = std::chrono::steady_clock::now();
+    sketch::loop();
+    cpuNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    maxLoopUs = max(maxLoopUs, sketch::loopStats.maxLoopUs);
+    if (sketch::loopStats.busyUs >= busyBeforeUs) {
+      busyUs += sketch::loopStats.busyUs - busyBeforeUs;
+    }
+    loops++;
+
+    if (host::nowUs == beforeUs) {
+      host::advance(STEP_US);
+    }
+  }
+
+  std::vector<Figure> figures = {
+    { "show_calls",  "",   (double) (FastLED.shows - shows) },
+    { "strip_bytes", "",   (double) (FastLED.bytesSent - stripBytes) },
+    { "log_bytes",   "",   (double) (TelnetStream.bytes - logBytes) },
+    { "time_events", "",   (double) (host::timeEvents - timeEvents) },
+    { "max_loop_us", "us", (double) maxLoopUs },
+    { "busy_ms",     "ms", busyUs / 1000.0 },
+    { "cpu_ms",      "ms", cpuNs / 1e6 }
+  };
+
+  printf("%lu loops in a simulated day\n", loops);
+  printf("%-12s %14s %14s\n", "figure", "value", "limit");
+  int failures = 0;
+  for (const Figure& figure : figures) {
+    auto limit = limits.find(figure.name);
+    if (limit == limits.end()) {
+      printf("%-12s %14.0f %14s %s\n", figure.name, figure.value, "-", figure.unit);
+      continue;
+    }
+    bool exceeded = figure.value > limit->second;
+    printf("%-12s %14.0f %14.0f %-2s%s\n", figure.name, figure.value, limit->second, figure.unit,
+           exceeded ? "  FAIL: over the limit" : "");
+    failures += exceeded;
+    limits.erase(limit);
+  }
+  for (const auto& unknown : limits) {
+    printf("FAIL: %s in %s is not a figure of this benchmark\n", unknown.first.c_str(), thresholdsPath);
+    failures++;
+  }
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+// Motion queue test
+//
+// A producer thread stands in for the motion ISR and a consumer thread for
+// loop(). Checks that edges come out in order and intact, that every edge is
+// either drained or counted as dropped, and measures how long an edge waits
+// in the queue. The last checks drive the sketch's own interrupt handler,
+// and check that an edge wakes the display within one loop().
+//
+//   make -C tools/host check   (or build/motion_queue_test)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "check.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace sketch {
+#include "sketch.inc"
+}
+
+unsigned long nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void checkOverflow() {
+  MotionQueue queue = {};
+  int accepted = 0;
+  for (int i = 0; i < 100; i++) {
+    accepted += motionQueuePush(queue, i, i % 2);
+  }
+  expect(accepted == (int) MOTION_QUEUE_SIZE, "a full queue accepts no more edges");
+  expect(motionQueueTakeDropped(queue) == 100 - MOTION_QUEUE_SIZE, "edges that did not fit are counted");
+  expect(motionQueueTakeDropped(queue) == 0, "the dropped count is reset once taken");
+
+  MotionEdge edge;
+  unsigned long expected = 0;
+  while (motionQueuePop(queue, edge)) {
+    expect(edge.ms == expected && edge.motion == (expected % 2), "a full queue keeps the oldest edges");
+    expected++;
+  }
+  expect(expected == MOTION_QUEUE_SIZE, "a full queue drains completely");
+}
+
+// The producer never waits for the consumer, like an ISR, and pushes bursts
+// of up to twice the queue size so some of them overflow. Edge i carries i as
+// its timestamp and i % 2 as its level.
+void checkOrdering() {
+  const unsigned long EDGES = 2000000;
+  MotionQueue queue = {};
+  std::atomic<bool> done(false);
+
+  std::thread producer([&] {
+    unsigned long i = 0;
+    while (i < EDGES) {
+      unsigned long burst = 1 + (i * 7919) % (2 * MOTION_QUEUE_SIZE);
+      for (unsigned long end = min(i + burst, EDGES); i < end; i++) {
+        motionQueuePush(queue, i, i % 2);
+      }
+      std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  unsigned long popped = 0;
+  unsigned long dropped = 0;
+  long last = -1;
+  bool ordered = true;
+  bool intact = true;
+  MotionEdge edge;
+  for (;;) {
+    bool finished = done;
+    while (motionQueuePop(queue, edge)) {
+      ordered &= (long) edge.ms > last;
+      intact &= edge.motion == (edge.ms % 2);
+      last = edge.ms;
+      popped++;
+    }
+    dropped += motionQueueTakeDropped(queue);
+    if (finished) {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  producer.join();
+
+  printf("ordering: %lu edges, %lu drained, %lu dropped\n", EDGES, popped, dropped);
+  expect(popped > EDGES / 10, "most bursts are drained");
+  expect(ordered, "edges are drained in the order they were pushed");
+  expect(intact, "edges are drained intact");
+  expect(popped + dropped == EDGES, "every edge is drained or counted as dropped");
+}
+
+// Edges every 200 us, much faster than a PIR sensor, timestamped in ns; the
+// consumer polls like loop().
+void checkLatency() {
+  const int EDGES = 5000;
+  MotionQueue queue = {};
+  std::atomic<bool> done(false);
+
+  std::thread producer([&] {
+    for (int i = 0; i < EDGES; i++) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      motionQueuePush(queue, nowNs(), i % 2);
+    }
+    done = true;
+  });
+
+  std::vector<unsigned long> latencies;
+  MotionEdge edge;
+  for (;;) {
+    bool finished = done;
+    while (motionQueuePop(queue, edge)) {
+      latencies.push_back(nowNs() - edge.ms);
+    }
+    if (finished) {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  producer.join();
+  uint32_t dropped = motionQueueTakeDropped(queue);
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentileUs = [&](double p) { return latencies[(size_t) (p * (latencies.size() - 1))] / 1000.0; };
+  printf("drain latency: p50 %.1f us  p99 %.1f us  max %.1f us  (%zu edges, %u dropped)\n",
+         percentileUs(0.5), percentileUs(0.99), percentileUs(1.0), latencies.size(), dropped);
+  expect(latencies.size() + dropped == (size_t) EDGES, "every timed edge is drained or counted as dropped");
+  expect(percentileUs(0.5) < 1000, "edges wait less than 1 ms in the queue");
+}
+
+// The sketch keeps the time of the edge, not the time it was drained
+void checkSketch() {
+  host::nowUs = 0;
+  sketch::lastMotion = false;
+  attachInterrupt(digitalPinToInterrupt(sketch::PIN_MOTION), sketch::onMotionEdge, CHANGE);
+
+  host::nowUs = 5000000;
+  host::setPin(sketch::PIN_MOTION, HIGH);
+  host::nowUs = 5400000;
+  host::setPin(sketch::PIN_MOTION, LOW);
+  host::nowUs = 9000000;
+  sketch::checkMotion();
+
+  expect(sketch::lastMotionDetectedMs == 5400, "the sketch keeps the time of the last edge");
+  expect(sketch::lastMotion == false, "the sketch keeps the level of the last edge");
+}
+
+// An edge from the ISR thread wakes a dark display within one loop(), before
+// the power state or brightness task would run again
+void checkWake() {
+  sketch::setup();
+  for (int i = 0; i < sketch::LIGHT_BUFFER_SIZE; i++) {
+    sketch::lightBuffer[i] = 1500;
+  }
+  host::advance(sketch::NO_MOTION_THRESHOLD_DAY_MS * 1000ULL);
+  sketch::enterPowerState(sketch::POWER_DISPLAY_OFF);
+  expect(FastLED.getBrightness() == 0, "the display is dark with the display off");
+
+  unsigned long wakeMs = millis();
+  for (int i = 0; i < sketch::NUM_TASKS; i++) {
+    sketch::tasks[i].previous = wakeMs;
+  }
+  std::thread isr([] { host::setPin(sketch::PIN_MOTION, HIGH); });
+  isr.join();
+  sketch::loop();
+
+  unsigned long wokeAfterMs = millis() - wakeMs;
+  printf("wake: display on after %lu ms of the sketch's time, brightness %d\n",
+         wokeAfterMs, FastLED.getBrightness());
+  expect(sketch::powerState == sketch::POWER_ACTIVE, "an edge wakes the clock in the next loop()");
+  expect(FastLED.getBrightness() > 0, "an edge lights the display in the next loop()");
+  expect(sketch::tasks[sketch::TASK_BRIGHTNESS].previous == wakeMs
+         && sketch::tasks[sketch::TASK_POWER_STATE].previous == wakeMs,
+         "the wake does not wait for the power state or brightness task");
+  expect(wokeAfterMs < sketch::powerProfiles[sketch::POWER_ACTIVE].brightnessInterval,
+         "the display is lit before the next brightness task");
+}
+
+int main() {
+  checkOverflow();
+  checkOrdering();
+  checkLatency();
+  checkSketch();
+  checkWake();
+
+  return checksPassed("motion queue");
+}
@@ -0,0 +1,80 @@
+// Streaming OTA receiver on a loopback socket
+//
+// Runs OTAStream.h as the clock does, setupOTAStream() and its task on a
+// thread, for ota_stream_test.py to send images to with tools/ota_pack.py.
+// RUNNING is loaded into both partitions of the flash in memory: the running
+// one, so delta images decode against it, and the update partition, which
+// holds an older build on the clock, so a chunk written without erasing
+// first comes out wrong. Prints "port N" with the port the receiver
+// listens on, then the device log.
+//
+// When stdin closes, prints what the sessions left behind: flash writes,
+// stored progress and boot partition, and writes the update partition to
+// OUTPUT.
+//
+//   build/ota_receiver SECRET RUNNING OUTPUT
+
+#include <Arduino.h>
+#include <OTATelnetStream.h>
+#include "OTAStream.h"
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+// ESP.restart() after an update: the clock would boot the new image, the
+// receiver keeps its state for the report
+void onRestart() {
+  printf("restart\n");
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s SECRET RUNNING OUTPUT\n", argv[0]);
+    return 1;
+  }
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* target = esp_ota_get_next_update_partition(NULL);
+  FILE* image = fopen(argv[2], "rb");
+  if (image == NULL) {
+    fprintf(stderr, "cannot read %s\n", argv[2]);
+    return 1;
+  }
+  size_t runningSize = fread(host::partitionData(running), 1, running->size, image);
+  fclose(image);
+  memcpy(host::partitionData(target), host::partitionData(running), runningSize);
+  printf("running image %zu bytes in %s and %s\n", runningSize, running->label, target->label);
+
+  host::realTime = true;
+  host::runTasks = true;
+  host::network = true;
+  host::echoLog = true;
+  host::onRestart = onRestart;
+  setupOTAStream(argv[1]);
+  printf("port %u\n", otaStreamServer.port());
+
+  while (getchar() != EOF) {
+  }
+
+  uint8_t storedSha256[OTA_SHA256_SIZE];
+  printf("flash writes %lu\n", host::flashWrites);
+  if (otaStreamPrefs.getBytes("sha256", storedSha256, sizeof(storedSha256)) == sizeof(storedSha256)) {
+    printf("stored progress %u\n", otaStreamPrefs.getUInt("next"));
+  } else {
+    printf("stored progress none\n");
+  }
+  printf("boot partition %s\n", host::bootPartition->label);
+
+  FILE* output = fopen(argv[3], "wb");
+  if (output == NULL || fwrite(host::partitionData(target), 1, target->size, output) != target->size) {
+    fprintf(stderr, "cannot write %s\n", argv[3]);
+    _exit(1);
+  }
+  fclose(output);
+  fflush(stdout);
+  _exit(0); // the OTA task never returns
+}
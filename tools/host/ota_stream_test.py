@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Loopback tests for tools/ota_pack.py against the receiver in OTAStream.h.
+
+  python3 tools/host/ota_stream_test.py   (or make -C tools/host check)
+
+Receiver runs build/ota_receiver, which is otaHandleClient() and the rest of
+OTAStream.h built against the host stand-ins: real sockets, the inflater,
+SHA-256 and HMAC, and flash partitions in memory. Proxy sits between
+ota_pack.send() and the receiver and drops the link after the device has
+accepted a number of chunks, to test that send() resumes where the device
+left off.
+"""
+
+import io
+import os
+import random
+import re
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import unittest
+from contextlib import redirect_stdout
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, ".."))
+import ota_pack  # noqa: E402
+
+RECEIVER = os.path.join(HERE, "build", "ota_receiver")
+SECRET = "host password"
+
+
+class Receiver:
+    def __init__(self, running, secret=SECRET):
+        self.directory = tempfile.TemporaryDirectory()
+        running_path = os.path.join(self.directory.name, "running.bin")
+        self.flash_path = os.path.join(self.directory.name, "ota_1.bin")
+        with open(running_path, "wb") as f:
+            f.write(running)
+
+        self.process = subprocess.Popen([RECEIVER, secret, running_path, self.flash_path],
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+        self.log = []
+        for line in self.process.stdout:
+            self.log.append(line.rstrip())
+            if line.startswith("port "):
+                self.port = int(line.split()[1])
+                break
+        self.reader = threading.Thread(target=self.read_log, daemon=True)
+        self.reader.start()
+
+    def read_log(self):
+        for line in self.process.stdout:
+            self.log.append(line.rstrip())
+
+    def close(self):
+        """Ends the receiver and reads what its sessions left behind"""
+        self.process.stdin.close()
+        self.process.wait(timeout=30)
+        self.reader.join()
+        self.process.stdout.close()
+        with open(self.flash_path, "rb") as f:
+            self.flash = f.read()
+        self.directory.cleanup()
+
+        report = "\n".join(self.log)
+        self.writes = int(re.search(r"^flash writes (\d+)$", report, re.M).group(1))
+        progress = re.search(r"^stored progress (\w+)$", report, re.M).group(1)
+        self.progress = None if progress == "none" else int(progress)
+        self.booted = re.search(r"^boot partition (\w+)$", report, re.M).group(1) == "ota_1"
+        self.resumed_at = [int(chunk) for chunk in re.findall(r"resuming at chunk (\d+)", report)]
+
+
+class Proxy:
+    def __init__(self, device_port, drop_after):
+        self.device_port = device_port
+        self.drop_after = list(drop_after)  # chunks to pass per connection before dropping it
+        self.sessions = []
+        self.server = socket.socket()
+        self.server.bind(("127.0.0.1", 0))
+        self.server.listen(1)
+        self.port = self.server.getsockname()[1]
+        self.thread = threading.Thread(target=self.serve, daemon=True)
+        self.thread.start()
+
+    def close(self):
+        """Waits until the device has ended every session"""
+        self.server.shutdown(socket.SHUT_RDWR)
+        self.server.close()
+        self.thread.join()
+        for session in self.sessions:
+            session.join(timeout=30)
+
+    def serve(self):
+        while True:
+            try:
+                client, _ = self.server.accept()
+            except OSError:
+                return
+            device = socket.create_connection(("127.0.0.1", self.device_port))
+            drop_after = self.drop_after.pop(0) if self.drop_after else None
+            threading.Thread(target=self.forward, args=(client, device, drop_after), daemon=True).start()
+            session = threading.Thread(target=self.forward_replies, args=(device, client), daemon=True)
+            session.start()
+            self.sessions.append(session)
+
+    def forward(self, client, device, drop_after):
+        # the signed header, then record by record, so the link drops between
+        # two chunks and the device gets every chunk sent before the drop
+        try:
+            device.sendall(ota_pack.receive_exact(client, ota_pack.HEADER_SIZE + 32))
+            chunks = 0
+            while drop_after is None or chunks < drop_after:
+                header = ota_pack.receive_exact(client, 11)
+                length = struct.unpack_from("<H", header, 5)[0]
+                device.sendall(header + ota_pack.receive_exact(client, length))
+                chunks += 1
+        except (OSError, ConnectionError):
+            pass
+        for sock, how in ((device, socket.SHUT_WR), (client, socket.SHUT_RDWR)):
+            try:
+                sock.shutdown(how)
+            except OSError:
+                pass
+
+    def forward_replies(self, device, client):
+        # until the device ends the session, whether the client is still there
+        # or not
+        try:
+            while True:
+                data = device.recv(65536)
+                if not data:
+                    break
+                try:
+                    client.sendall(data)
+                except OSError:
+                    pass
+        except OSError:
+            pass
+        device.close()
+        client.close()
+
+
+def firmware(size, seed):
+    # code like data: repeated blocks with some noise, so chunks compress
+    generator = random.Random(seed)
+    blocks = [bytes(generator.getrandbits(8) for _ in range(64)) for _ in range(32)]
+    image = bytearray()
+    while len(image) < size:
+        image += generator.choice(blocks)
+        image += bytes(generator.getrandbits(8) for _ in range(generator.randrange(8)))
+    return bytes(image[:size])
+
+
+def packed_size(image, base):
+    return sum(len(record) for record in ota_pack.pack(image, base)[1])
+
+
+class OtaStreamTest(unittest.TestCase):
+    def setUp(self):
+        self.running = firmware(100000, 1)
+        self.image = bytearray(self.running)
+        # a rebuild: a few bytes change in a few places and the image grows
+        for offset in (100, 30000, 77777):
+            self.image[offset:offset + 8] = b"CHANGED!"
+        self.image = bytes(self.image) + firmware(5000, 2)
+
+    def send(self, port, image, base=b"", secret=SECRET, retries=3):
+        header, records = ota_pack.pack(image, base)
+        output = io.StringIO()
+        with redirect_stdout(output):
+            ota_pack.send(header, records, "127.0.0.1", port, secret, retries, retry_delay=0)
+        return records, output.getvalue()
+
+    def assertFlashed(self, receiver, image):
+        self.assertTrue(receiver.booted)
+        self.assertEqual(receiver.flash[:len(image)], image)
+        self.assertIsNone(receiver.progress, "progress is cleared after an update")
+
+    def test_full_image(self):
+        receiver = Receiver(self.running)
+        records, _ = self.send(receiver.port, self.image)
+        receiver.close()
+
+        self.assertFlashed(receiver, self.image)
+        self.assertEqual(receiver.writes, len(records))
+
+    def test_delta_image(self):
+        receiver = Receiver(self.running)
+        records, _ = self.send(receiver.port, self.image, base=self.running)
+        receiver.close()
+
+        self.assertFlashed(receiver, self.image)
+        full = packed_size(self.image, b"")
+        delta = sum(len(r) for r in records)
+        print("\ndelta after in place edits: %d of %d bytes (%.1f%%)" % (delta, full, 100.0 * delta / full))
+        self.assertLess(delta, full / 2, "delta chunks compress better")
+
+    def test_delta_after_an_insertion(self):
+        # code that moves gains nothing from a per sector xor: every chunk
+        # after the insertion is sent deflated on its own
+        insert_at = 50000
+        image = self.running[:insert_at] + firmware(300, 3) + self.running[insert_at:]
+        header, records = ota_pack.pack(image, self.running)
+        flags = [record[4] for record in records]
+        first_moved = insert_at // ota_pack.CHUNK_SIZE
+
+        receiver = Receiver(self.running)
+        self.send(receiver.port, image, base=self.running)
+        receiver.close()
+        self.assertFlashed(receiver, image)
+
+        full = packed_size(image, b"")
+        delta = sum(len(r) for r in records)
+        print("\ndelta after a 300 byte insertion: %d of %d bytes (%.1f%%), %d of %d chunks xor'd"
+              % (delta, full, 100.0 * delta / full, sum(f & ota_pack.DELTA != 0 for f in flags), len(flags)))
+        self.assertTrue(all(f & ota_pack.DELTA for f in flags[:first_moved]), "chunks before it are deltas")
+        self.assertFalse(any(f & ota_pack.DELTA for f in flags[first_moved + 1:]), "chunks after it are not")
+        self.assertGreater(delta, full * first_moved // len(flags), "the delta saves at most the unmoved chunks")
+
+    def test_wrong_secret_is_rejected_before_writing(self):
+        receiver = Receiver(self.running)
+        with self.assertRaises(SystemExit):
+            self.send(receiver.port, self.image, secret="wrong")
+        receiver.close()
+
+        self.assertFalse(receiver.booted)
+        self.assertEqual(receiver.writes, 0)
+        self.assertIsNone(receiver.progress)
+        self.assertIn("[ERROR] OTA header is not signed with the OTA secret", receiver.log)
+
+    def test_replayed_header_is_rejected(self):
+        receiver = Receiver(self.running)
+        header, _ = ota_pack.pack(self.image, b"")
+        with socket.create_connection(("127.0.0.1", receiver.port)) as sock:
+            nonce = ota_pack.receive_exact(sock, ota_pack.NONCE_SIZE)
+            signed = header + ota_pack.sign(header, nonce, SECRET)
+            sock.sendall(signed)
+            self.assertEqual(ota_pack.receive_u32(sock), 0)
+        with socket.create_connection(("127.0.0.1", receiver.port)) as sock:
+            ota_pack.receive_exact(sock, ota_pack.NONCE_SIZE)
+            sock.sendall(signed)
+            self.assertEqual(ota_pack.receive_u32(sock), ota_pack.ERROR)
+        receiver.close()
+
+        self.assertEqual(receiver.resumed_at, [0])
+        self.assertEqual(receiver.writes, 0)
+
+    def test_dropped_connection_resumes(self):
+        receiver = Receiver(self.running)
+        proxy = Proxy(receiver.port, drop_after=[5, 3])
+        records, output = self.send(proxy.port, self.image, base=self.running)
+        proxy.close()
+        receiver.close()
+
+        self.assertFlashed(receiver, self.image)
+        self.assertEqual(receiver.resumed_at, [0, 5, 8])
+        self.assertEqual(receiver.writes, len(records), "no chunk is written twice")
+        self.assertIn("retrying (1/3)", output)
+        self.assertIn("retrying (2/3)", output)
+
+    def test_gives_up_after_the_last_retry(self):
+        receiver = Receiver(self.running)
+        proxy = Proxy(receiver.port, drop_after=[1, 1, 1])
+        output = io.StringIO()
+        header, records = ota_pack.pack(self.image, b"")
+        with redirect_stdout(output), self.assertRaises(SystemExit) as exit:
+            ota_pack.send(header, records, "127.0.0.1", proxy.port, SECRET, 2, retry_delay=0)
+        proxy.close()
+        receiver.close()
+
+        self.assertEqual(exit.exception.code, "giving up")
+        self.assertEqual(receiver.resumed_at, [0, 1, 2])
+        self.assertEqual(receiver.progress, 3, "the device keeps the chunks it accepted")
+        self.assertFalse(receiver.booted)
+        self.assertIn("retrying (2/2)", output.getvalue())
+        self.assertNotIn("(3/2)", output.getvalue())
+
+
+if __name__ == "__main__":
+    unittest.main()
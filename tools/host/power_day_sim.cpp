@@ -0,0 +1,108 @@
+// Power profile energy estimate
+//
+// Runs the sketch through the scripted day in day.h on the virtual clock:
+// setup() once, then loop() with the PIR and light sensor driven by the
+// script, so power states change through checkMotion(), updatePowerState()
+// and nextPowerState() exactly as on the clock. Every step is charged at the
+// current of the CPU clock and WiFi power save mode the stand-ins were last
+// set to, plus the LEDs lit at the current brightness. The total is compared
+// with staying in the active profile all day.
+//
+// The currents are estimates from the ESP32 datasheet ranges and SK9822
+// specs, good for comparing profiles rather than sizing a power supply.
+//
+//   make -C tools/host check   (or build/power_day_sim)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "day.h"
+
+namespace sketch {
+#include "sketch.inc"
+}
+
+const unsigned long long STEP_US = 10000; // one pass of an idle loop()
+
+// ESP32 with WiFi associated: CPU at the given clock plus the radio, which is
+// always listening without power save, wakes for every DTIM beacon with modem
+// sleep and for every third one with max modem sleep
+double espMilliamps(uint32_t mhz, wifi_ps_type_t powerSave) {
+  double cpu = (mhz >= 240) ? 40 : (mhz >= 160) ? 30 : 20;
+  double radio = (powerSave == WIFI_PS_NONE) ? 80 : (powerSave == WIFI_PS_MIN_MODEM) ? 12 : 4;
+  return cpu + radio;
+}
+
+// SK9822: about 1 mA per LED when dark, 60 mA for full white
+double ledMilliamps(int litLeds, int brightness) {
+  return (sketch::NUM_LEDS * 0.9) + (litLeds * 60.0 * brightness / 255);
+}
+
+int main() {
+  sketch::setup();
+
+  bool bootMatches = host::cpuMhz == sketch::powerProfiles[sketch::powerState].cpuMhz
+                  && WiFi.getSleep() == sketch::powerProfiles[sketch::powerState].wifiPowerSave;
+
+  const int NUM_STATES = 4;
+  double stateSeconds[NUM_STATES] = {};
+  double stateMilliampSeconds[NUM_STATES] = {};
+  double activeMilliampSeconds = 0;
+
+  unsigned long long startUs = host::nowUs;
+  unsigned long long endUs = startUs + day::SECONDS * 1000000ULL;
+  while (host::nowUs < endUs) {
+    unsigned long long beforeUs = host::nowUs;
+    day::drive(millis() / 1000, sketch::PIN_MOTION, sketch::PIN_LIGHT);
+
+    sketch::loop();
+    if (host::nowUs == beforeUs) {
+      host::advance(STEP_US);
+    }
+
+    double seconds = (host::nowUs - beforeUs) / 1e6;
+    int litLeds = sketch::frame.numShown;
+    double milliamps = espMilliamps(host::cpuMhz, WiFi.getSleep()) + ledMilliamps(litLeds, FastLED.getBrightness());
+    stateSeconds[sketch::powerState] += seconds;
+    stateMilliampSeconds[sketch::powerState] += milliamps * seconds;
+
+    // the same step in the active profile: full clock, modem sleep, never dark
+    activeMilliampSeconds += (espMilliamps(sketch::powerProfiles[sketch::POWER_ACTIVE].cpuMhz,
+                                           sketch::powerProfiles[sketch::POWER_ACTIVE].wifiPowerSave)
+                              + ledMilliamps(litLeds, sketch::calculateBrightness())) * seconds;
+  }
+
+  printf("%-12s %8s %8s %8s\n", "state", "hours", "avg mA", "mAh");
+  double totalMah = 0;
+  for (int state = 0; state < NUM_STATES; state++) {
+    double mah = stateMilliampSeconds[state] / 3600;
+    totalMah += mah;
+    printf("%-12s %8.2f %8.1f %8.1f\n", sketch::powerProfiles[state].name, stateSeconds[state] / 3600,
+           (stateSeconds[state] > 0) ? stateMilliampSeconds[state] / stateSeconds[state] : 0.0, mah);
+  }
+  double activeMah = activeMilliampSeconds / 3600;
+  printf("%-12s %17s %8.1f mAh/day (%.1f Wh at 5 V)\n", "total", "", totalMah, totalMah * 5 / 1000);
+  printf("%-12s %17s %8.1f mAh/day, profiles save %.0f%%\n", "always active", "", activeMah,
+         100 * (1 - totalMah / activeMah));
+
+  int failures = 0;
+  if (!bootMatches) {
+    printf("FAIL: the clock does not boot with the CPU clock and WiFi power save of its power state\n");
+    failures++;
+  }
+  if (stateSeconds[sketch::POWER_DEEP_IDLE] == 0 || stateSeconds[sketch::POWER_ACTIVE] == 0) {
+    printf("FAIL: the day does not go through every power state\n");
+    failures++;
+  }
+  if (totalMah >= activeMah) {
+    printf("FAIL: the power profiles use more energy than staying active\n");
+    failures++;
+  }
+  for (int state = 0; state < NUM_STATES; state++) {
+    if (sketch::powerProfiles[state].wifiPowerSave == WIFI_PS_NONE) {
+      printf("FAIL: %s turns modem sleep off, which costs more than the arduino-esp32 default\n",
+             sketch::powerProfiles[state].name);
+      failures++;
+    }
+  }
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+// Scroll benchmark
+//
+// Scrolls messages through scrollText() on the sketch's 11 column grid and on
+// a 96 column build of it (see the Makefile), where a row of the screen takes
+// three words. Every step is compared LED for LED with the message worked out
+// pixel by pixel, then a step of shifting and ORing the packed rows is timed
+// against working out every pixel again.
+//
+//   make -C tools/host check   (or build/scroll_bench)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "check.h"
+#include <chrono>
+#include <vector>
+
+namespace sketch {
+#include "sketch.inc"
+#include "scroll_check.h"
+}
+
+namespace wide {
+#include "sketch_wide.inc"
+#include "scroll_check.h"
+}
+
+const char* const MESSAGES[] = {
+  "Hello",
+  "It is 21*C - 100% OK? 12:34 +/- #unknown!",
+  "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz!."
+};
+
+int main() {
+  sketch::buildLedMap();
+  wide::buildLedMap();
+
+  for (const char* message : MESSAGES) {
+    expect(sketch::checkScroll(message), "scrolling on 11 columns matches the reference");
+    expect(wide::checkScroll(message), "scrolling on 96 columns matches the reference");
+  }
+
+  const char* longest = MESSAGES[2];
+  sketch::benchmarkScroll("sketch", longest, 200);
+  wide::benchmarkScroll("wide", longest, 200);
+
+  return checksPassed("scroll");
+}
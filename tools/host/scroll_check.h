@@ -0,0 +1,92 @@
+// Scroll checks and timing for one grid width. Included by scroll_bench.cpp
+// inside the namespace of each sketch configuration, so the names below are
+// that configuration's.
+
+// The message as columns of pixels, one glyph column at a time
+std::vector<uint8_t> referenceColumns(const char* message) {
+  std::vector<uint8_t> columns;
+  for (const char* c = message; *c != '\0'; c++) {
+    const char* glyph = strchr(GLYPH_CHARS, toupper((unsigned char) *c));
+    int glyphIndex = (glyph != NULL) ? glyph - GLYPH_CHARS : 0;
+    for (int i = 0; i < GLYPH_WIDTH; i++) {
+      columns.push_back(GLYPHS[glyphIndex][i]);
+    }
+    columns.push_back(0);
+  }
+  columns.resize(columns.size() + NUM_COLS, 0);
+  return columns;
+}
+
+// After step columns have scrolled in, the newest one is in the rightmost
+// grid column
+bool referencePixel(const std::vector<uint8_t>& columns, int step, int row, int col) {
+  int index = step - NUM_COLS + col;
+  return index >= 0 && index < (int) columns.size() && ((columns[index] >> row) & 1);
+}
+
+// Every step of a message, LED for LED against the reference
+bool checkScroll(const char* message) {
+  std::vector<uint8_t> columns = referenceColumns(message);
+  queueMessage(message);
+  bool matches = true;
+  int step = 0;
+  for (;;) {
+    scrollText();
+    if (!scrolling) {
+      break;
+    }
+    step++;
+
+    boolean expected[NUM_LEDS] = {};
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      for (int col = 0; col < NUM_COLS; col++) {
+        if (referencePixel(columns, step, row, col)) {
+          expected[convertFrom2DTo1D(SCROLL_TOP_ROW + row, col)] = true;
+        }
+      }
+    }
+    for (int i = 0; i < NUM_LEDS; i++) {
+      matches &= expected[i] == (leds[i] != CRGB(CRGB::Black));
+    }
+  }
+  return matches && step == (int) columns.size();
+}
+
+// Every pixel of the text rows worked out again on each step
+void perPixelStep(const std::vector<uint8_t>& columns, int step) {
+  for (int row = 0; row < GLYPH_HEIGHT; row++) {
+    for (int col = 0; col < NUM_COLS; col++) {
+      if (referencePixel(columns, step, row, col)) {
+        displayLed(SCROLL_TOP_ROW + row, col);
+      }
+    }
+  }
+  updateDisplayAndClearBuffer();
+}
+
+void benchmarkScroll(const char* name, const char* message, int repeats) {
+  std::vector<uint8_t> columns = referenceColumns(message);
+  long steps = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; i++) {
+    queueMessage(message);
+    do {
+      scrollText();
+      steps++;
+    } while (scrolling);
+  }
+  double shiftNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / steps;
+
+  long pixelSteps = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; i++) {
+    for (int step = 1; step <= (int) columns.size(); step++) {
+      perPixelStep(columns, step);
+      pixelSteps++;
+    }
+  }
+  double pixelNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / pixelSteps;
+
+  printf("%-8s %3d cols, %d row words  shift and OR %7.1f ns  per pixel %7.1f ns per step\n",
+         name, NUM_COLS, SCROLL_ROW_WORDS, shiftNs, pixelNs);
+}
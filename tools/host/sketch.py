@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Turn the sketch into C++ a host program can include (see tools/host/Makefile).
+
+  sketch.py ../../wordclock.c -o build/sketch.inc [--includes build/sketch_includes.h]
+            [--set NAME=VALUE ...] [--thread-local]
+
+Like the Arduino builder, this adds a prototype for every function before the
+first function definition, so the sketch compiles as plain C++. The sketch's
+#define and #include lines go to --includes instead, so a host program can
+include them once and then include the body inside a namespace, once per
+configuration.
+
+--set NAME=VALUE replaces the value of a top level constant, e.g.
+--set DISPLAY_IT_IS=true. --thread-local makes every top level variable
+thread_local, so each thread of a host program gets its own clock.
+"""
+
+import argparse
+import re
+import sys
+
+FUNCTION = re.compile(r"^((?:static |inline )*[A-Za-z_][\w<>:]*[ *&]+(?:IRAM_ATTR )?([A-Za-z_]\w*)\([^;{)]*\))\s*\{",
+                      re.M)
+NOT_A_VARIABLE = re.compile(r"^(const |static_assert|typedef |enum |struct |class |template|#|//|/\*|\}|\{)")
+
+
+def prototypes(body):
+    found = []
+    for match in FUNCTION.finditer(body):
+        signature = match.group(1)
+        if re.match(r"(if|for|while|switch|else|return)\b", signature):
+            continue
+        found.append((match.start(), signature + ";"))
+    return found
+
+
+def set_constants(body, settings):
+    for setting in settings:
+        name, value = setting.split("=", 1)
+        pattern = re.compile(r"^(const [^=;]*\b%s\s*=\s*)[^;]*;" % re.escape(name), re.M)
+        body, count = pattern.subn(lambda m: m.group(1) + value + ";", body)
+        if count != 1:
+            sys.exit("no constant %s in the sketch" % name)
+    return body
+
+
+def make_thread_local(body):
+    lines = body.split("\n")
+    depth = 0
+    for i, line in enumerate(lines):
+        code = re.sub(r"//.*", "", line)
+        if depth == 0 and line[:1].isalpha() and not NOT_A_VARIABLE.match(line):
+            stripped = code.rstrip()
+            is_function = "(" in stripped and stripped.endswith("{") and "=" not in stripped
+            if not is_function and (stripped.endswith(";") or stripped.endswith("{")):
+                lines[i] = "thread_local " + line
+        depth += code.count("{") - code.count("}")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("sketch")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--includes")
+    parser.add_argument("--set", action="append", default=[])
+    parser.add_argument("--thread-local", action="store_true")
+    args = parser.parse_args()
+
+    with open(args.sketch) as f:
+        source = f.read()
+
+    preprocessor = re.compile(r"^#(define|include)\b.*\n", re.M)
+    includes = "".join(m.group(0) for m in preprocessor.finditer(source))
+    body = preprocessor.sub("", source)
+
+    body = set_constants(body, args.set)
+    if args.thread_local:
+        body = make_thread_local(body)
+
+    found = prototypes(body)
+    if found:
+        first = found[0][0]
+        body = body[:first] + "\n".join(p for _, p in found) + "\n" + body[first:]
+
+    with open(args.output, "w") as f:
+        f.write(body)
+    if args.includes:
+        with open(args.includes, "w") as f:
+            f.write(includes)
+
+
+if __name__ == "__main__":
+    main()
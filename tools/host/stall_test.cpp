@@ -0,0 +1,154 @@
+// Stall watchdog test
+//
+// Runs the sketch on the wall clock with its watchdog task on a thread, and
+// with the stall thresholds scaled down (see the Makefile). A task that
+// blocks the loop stands in for a hung fade or TelnetStream write. Checks
+// that:
+// - a stall recorded before a restart is reported on the next boot
+// - the watchdog notices a stall within its threshold and logs nothing itself
+// - loop() reports a stall it recovers from once, and clears the record
+// - a stall that does not recover restarts the clock with the culprit in RTC
+//   memory, and the boot after it reports the culprit
+// and measures what the heartbeat and task ring cost per task run.
+//
+//   make -C tools/host check   (or build/stall_test)
+
+#include <Arduino.h>
+#include "sketch_includes.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace sketch {
+#include "sketch_stall.inc"
+}
+
+bool logged(const char* text) {
+  return host::logCapture.find(text) != std::string::npos;
+}
+
+std::atomic<bool> restarted(false);
+unsigned long stallForMs;
+unsigned long detectedAfterMs;
+unsigned long long bytesLoggedWhileStalled;
+
+// ESP.restart() never returns, so neither does the watchdog thread
+void onRestart() {
+  restarted = true;
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+}
+
+// Blocks the loop for stallForMs, or until the watchdog restarts the clock
+void stallingTask() {
+  unsigned long startMs = millis();
+  unsigned long long bytes = TelnetStream.bytes;
+  detectedAfterMs = 0;
+  while (millis() - startMs < stallForMs && !restarted) {
+    if (detectedAfterMs == 0 && sketch::stallRecord.stalled) {
+      detectedAfterMs = millis() - startMs;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  bytesLoggedWhileStalled = TelnetStream.bytes - bytes;
+}
+
+void runStallingTask() {
+  sketch::tasks[sketch::TASK_EVENTS].function = stallingTask;
+  sketch::tasks[sketch::TASK_EVENTS].previous = millis() - sketch::tasks[sketch::TASK_EVENTS].interval;
+  sketch::loop();
+}
+
+void checkBootReport() {
+  // what the last run left in RTC memory
+  sketch::stallRecord.magic = sketch::STALL_RECORD_MAGIC;
+  sketch::stallRecord.stalled = true;
+  sketch::stallRecord.task = sketch::TASK_BRIGHTNESS;
+  sketch::stallRecord.stalledMs = 61234;
+  for (int i = 0; i < 20; i++) {
+    sketch::stallRecord.ring[i % sketch::STALL_RING_SIZE] = { (int8_t) (i % sketch::NUM_TASKS), (uint32_t) (1000 * i) };
+  }
+  sketch::stallRecord.ringIndex = 20;
+
+  host::captureLog = true;
+  host::logCapture.clear();
+  sketch::setup();
+
+  expect(logged("[ERROR] Restarted after the loop stalled in brightness for 61234 ms"),
+         "the boot reports the task the last run stalled in");
+  expect(logged("15000 ms  loop statistics"), "the boot reports the last tasks entered");
+  expect(!sketch::stallRecord.stalled, "the boot clears the stall record");
+}
+
+void checkRecoveredStall() {
+  stallForMs = sketch::STALL_THRESHOLD_MS * 2;
+  runStallingTask();
+  printf("stall detected after %lu ms (threshold %lu ms, checked every %lu ms)\n",
+         detectedAfterMs, sketch::STALL_THRESHOLD_MS, sketch::STALL_CHECK_MS);
+  expect(detectedAfterMs >= sketch::STALL_THRESHOLD_MS, "no stall is seen before the threshold");
+  expect(detectedAfterMs > 0 && detectedAfterMs <= sketch::STALL_THRESHOLD_MS + 3 * sketch::STALL_CHECK_MS,
+         "the watchdog sees a stall within a few checks of the threshold");
+  expect(bytesLoggedWhileStalled == 0, "the watchdog does not log");
+  expect(sketch::stallRecord.task == sketch::TASK_EVENTS, "the stall record names the stalled task");
+
+  host::logCapture.clear();
+  sketch::loop();
+  expect(logged("[WARNING] Loop stalled in ezTime events"), "loop() reports a stall it recovered from");
+  expect(!sketch::stallRecord.stalled, "loop() clears a stall it reported");
+
+  host::logCapture.clear();
+  sketch::loop();
+  expect(!logged("stalled"), "a stall is reported once");
+  expect(!restarted, "a stall that recovers does not restart the clock");
+}
+
+void checkRestart() {
+  host::onRestart = onRestart;
+  stallForMs = sketch::STALL_RESTART_MS * 3;
+  unsigned long startMs = millis();
+  runStallingTask();
+  unsigned long restartedAfterMs = millis() - startMs;
+
+  printf("restarted after %lu ms (restart at %lu ms)\n", restartedAfterMs, sketch::STALL_RESTART_MS);
+  expect(restarted, "a stall that does not recover restarts the clock");
+  expect(restartedAfterMs <= sketch::STALL_RESTART_MS + 3 * sketch::STALL_CHECK_MS,
+         "the restart comes within a few checks of STALL_RESTART_MS");
+  expect(sketch::stallRecord.stalled && sketch::stallRecord.task == sketch::TASK_EVENTS,
+         "the culprit is in RTC memory at the restart");
+  const sketch::TaskEntry& last = sketch::stallRecord.ring[(sketch::stallRecord.ringIndex - 1) % sketch::STALL_RING_SIZE];
+  expect(last.task == sketch::TASK_EVENTS, "the ring ends with the stalled task");
+
+  // the next boot, as far as the watchdog goes
+  host::logCapture.clear();
+  sketch::setupStallWatchdog();
+  sketch::reportBootStall();
+  expect(logged("[ERROR] Restarted after the loop stalled in ezTime events"), "the next boot reports the culprit");
+}
+
+// What loop() adds per task run: the heartbeat, the ring entry and resetting
+// the current task
+void measureOverhead() {
+  const int RUNS = 1000000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    sketch::heartbeatMs = millis();
+    sketch::enterTask(i % sketch::NUM_TASKS);
+    sketch::currentTask = sketch::LOOP_TASK;
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / RUNS;
+  printf("heartbeat and task entry: %.1f ns per task run on the host\n", ns);
+}
+
+int main() {
+  host::realTime = true;
+  host::runTasks = true;
+
+  checkBootReport();
+  measureOverhead();
+  checkRecoveredStall();
+  checkRestart();
+
+  return checksPassed("stall watchdog");
+}
@@ -0,0 +1,225 @@
+// Host stand-in for the Arduino core
+//
+// Just enough of the ESP32 Arduino core to build the sketch on a PC. Time is
+// virtual: millis() and micros() only move when a test calls delay() or
+// host::advance(), so a simulated day runs in seconds. Pins, tasks and
+// restarts are driven through the host namespace at the bottom.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+
+void setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_random();
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s(s) {}
+  String(const std::string& s) : s(s) {}
+
+  const char* c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  char operator[](unsigned int i) const { return s[i]; }
+  String operator+(const String& other) const { return String(s + other.s); }
+  friend String operator+(const char* left, const String& right) { return String(left + right.s); }
+
+  void trim() {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    size_t last = s.find_last_not_of(" \t\r\n");
+    s = (first == std::string::npos) ? "" : s.substr(first, last - first + 1);
+  }
+
+private:
+  std::string s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char* s) { return write((const uint8_t*) s, strlen(s)); }
+  virtual void flush() {}
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(int n, int base = DEC) { return print((long) n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+  size_t print(long n, int base = DEC) { return format(base == HEX ? "%lx" : "%ld", n); }
+  size_t print(unsigned long n, int base = DEC) { return format(base == HEX ? "%lx" : "%lu", n); }
+  size_t print(long long n, int base = DEC) { return format(base == HEX ? "%llx" : "%lld", n); }
+  size_t print(unsigned long long n, int base = DEC) { return format(base == HEX ? "%llx" : "%llu", n); }
+  size_t print(double n, int digits = 2) { return format("%.*f", digits, n); }
+
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(T value) { return print(value) + println(); }
+  template<typename T> size_t println(T value, int format) { return print(value, format) + println(); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vformat(format, args);
+    va_end(args);
+    return n;
+  }
+
+private:
+  size_t format(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vformat(format, args);
+    va_end(args);
+    return n;
+  }
+
+  size_t vformat(const char* format, va_list args) {
+    char buffer[512];
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    if (length <= 0) {
+      return 0;
+    }
+    return write((const uint8_t*) buffer, min((size_t) length, sizeof(buffer) - 1));
+  }
+};
+
+// Input comes from a string a test fills, output is dropped
+class Stream : public Print {
+public:
+  std::string input;
+
+  size_t write(uint8_t c) override { return 1; }
+  using Print::write;
+
+  virtual int available() { return input.size(); }
+  virtual int peek() { return input.empty() ? -1 : (uint8_t) input[0]; }
+  virtual int read() {
+    int c = peek();
+    if (c >= 0) {
+      input.erase(0, 1);
+    }
+    return c;
+  }
+
+  long parseInt() {
+    size_t end = 0;
+    long value = 0;
+    try {
+      value = std::stol(input, &end);
+    } catch (...) {
+    }
+    input.erase(0, end);
+    return value;
+  }
+
+  String readStringUntil(char terminator) {
+    size_t end = input.find(terminator);
+    String s(input.substr(0, end));
+    input.erase(0, (end == std::string::npos) ? input.size() : end + 1);
+    return s;
+  }
+
+  void setTimeout(unsigned long ms) {}
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) {}
+};
+extern HardwareSerial Serial;
+
+// FreeRTOS
+typedef void* TaskHandle_t;
+typedef int BaseType_t;
+#define portTICK_PERIOD_MS 1
+#define configMAX_PRIORITIES 25
+#define pdPASS 1
+void vTaskDelay(uint32_t ticks);
+BaseType_t xTaskCreate(void (*task)(void*), const char* name, uint32_t stackDepth, void* parameter,
+                       int priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackDepth, void* parameter,
+                                   int priority, TaskHandle_t* handle, int core);
+
+class EspClass {
+public:
+  void restart();
+  uint32_t getFreeHeap() { return 200000; }
+};
+extern EspClass ESP;
+
+namespace host {
+  // Virtual time in us. With realTime set, millis() and delay() follow the
+  // wall clock instead, for tests that run sketch tasks on threads.
+  extern unsigned long long nowUs;
+  extern bool realTime;
+  void advance(unsigned long long us);
+
+  // Pin levels and interrupt handlers. setPin() calls the handler attached to
+  // the pin like a CHANGE interrupt would.
+  extern int pinLevels[64];
+  extern int analogLevels[64];
+  void setPin(uint8_t pin, int level);
+
+  // Tasks from xTaskCreate() only run on a thread when runTasks is set
+  extern bool runTasks;
+
+  // Called by ESP.restart(); exits the process when not set
+  extern void (*onRestart)();
+
+  extern uint32_t cpuMhz;
+}
+
+#endif
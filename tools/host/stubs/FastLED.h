@@ -0,0 +1,59 @@
+// Host stand-in for FastLED
+//
+// Keeps the LED array and brightness, and counts show() calls and the bytes a
+// real SK9822 strip would be sent so benchmarks can report them.
+
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include "Arduino.h"
+
+struct CRGB {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+
+  enum HTMLColorCode {
+    Black = 0x000000,
+    White = 0xFFFFFF
+  };
+
+  CRGB() : r(0), g(0), b(0) {}
+  CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+  CRGB(HTMLColorCode color) : r((color >> 16) & 0xFF), g((color >> 8) & 0xFF), b(color & 0xFF) {}
+
+  bool operator==(const CRGB& other) const { return r == other.r && g == other.g && b == other.b; }
+  bool operator!=(const CRGB& other) const { return !(*this == other); }
+};
+
+enum EOrder { RGB, RBG, GRB, GBR, BRG, BGR };
+enum ESPIChipsets { APA102, SK9822 };
+
+class CFastLED {
+public:
+  CRGB* leds = NULL;
+  int numLeds = 0;
+  uint8_t brightness = 255;
+  unsigned long shows = 0;
+  unsigned long long bytesSent = 0;
+
+  template<ESPIChipsets CHIPSET, uint8_t DATA_PIN, uint8_t CLOCK_PIN, EOrder RGB_ORDER>
+  void addLeds(CRGB* data, int count) {
+    leds = data;
+    numLeds = count;
+  }
+
+  void show() {
+    shows++;
+    // start frame, 4 bytes per LED, reset frame, end frame of half a bit per LED
+    bytesSent += 4 + (numLeds * 4) + 4 + ((numLeds + 15) / 16);
+  }
+
+  void setBrightness(uint8_t scale) { brightness = scale; }
+  uint8_t getBrightness() { return brightness; }
+};
+extern CFastLED FastLED;
+
+inline void set_max_power_in_volts_and_milliamps(uint8_t volts, uint32_t milliamps) {}
+
+#endif
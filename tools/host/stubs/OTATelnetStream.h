@@ -0,0 +1,31 @@
+// Host stand-in for OTATelnetStream.h
+//
+// Counts every byte logged. Output is echoed to stdout with host::echoLog and
+// kept in host::logCapture with host::captureLog, for tests that check what
+// was reported.
+
+#ifndef HOST_OTA_TELNET_STREAM_H
+#define HOST_OTA_TELNET_STREAM_H
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+namespace host {
+  extern bool echoLog;
+  extern bool captureLog;
+  extern std::string logCapture;
+}
+
+class TelnetStreamClass : public Stream {
+public:
+  unsigned long long bytes = 0;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+};
+extern TelnetStreamClass TelnetStream;
+
+inline void setupOTA(const char* hostname, const char* ssid, const char* password) {}
+
+#endif
@@ -0,0 +1,35 @@
+// Host stand-in for Preferences (NVS)
+//
+// Values live in memory for the life of the process, so a test can "reboot"
+// the sketch and read back what it stored.
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false) {
+    space = name;
+    return true;
+  }
+  void end() {}
+  bool clear();
+
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) {
+    uint32_t value = defaultValue;
+    getBytes(key, &value, sizeof(value));
+    return value;
+  }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buffer, size_t length);
+  size_t putBytes(const char* key, const void* buffer, size_t length);
+
+private:
+  std::string space;
+};
+
+#endif
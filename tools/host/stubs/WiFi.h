@@ -0,0 +1,82 @@
+// Host stand-in for the ESP32 WiFi library
+//
+// Always connected. The modem sleep mode is kept so power tests can read it.
+// WiFiServer and WiFiClient are TCP sockets on 127.0.0.1, but a server only
+// listens when host::network is set, so host programs that run setup() do
+// not open ports. It then listens on any free port; port() tells which.
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include <memory>
+
+namespace host {
+  extern bool network;
+}
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+class WiFiClass {
+public:
+  wifi_ps_type_t sleepType = WIFI_PS_MIN_MODEM; // modem sleep is on by default
+
+  void begin(const char* ssid, const char* password) {}
+  wl_status_t status() { return WL_CONNECTED; }
+  bool setSleep(bool enabled) { return setSleep(enabled ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE); }
+  bool setSleep(wifi_ps_type_t type) {
+    sleepType = type;
+    return true;
+  }
+  wifi_ps_type_t getSleep() { return sleepType; }
+};
+extern WiFiClass WiFi;
+
+struct HostSocket;
+
+// Copies share the socket, which closes with the last copy or stop(), as on
+// the ESP32. Reads never block.
+class WiFiClient : public Stream {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+
+  operator bool();
+  bool connected();
+  int available() override;
+  int peek() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size);
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void setNoDelay(bool noDelay);
+  void stop();
+
+private:
+  std::shared_ptr<HostSocket> socket;
+};
+
+class WiFiServer {
+public:
+  WiFiServer(uint16_t port) {}
+  void begin();
+  WiFiClient available();
+  uint16_t port() { return boundPort; }
+
+private:
+  int listener = -1;
+  uint16_t boundPort = 0;
+};
+
+#endif
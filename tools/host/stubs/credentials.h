@@ -0,0 +1,9 @@
+// Host stand-in for the credentials.h every clock keeps out of the repo
+
+#ifndef HOST_CREDENTIALS_H
+#define HOST_CREDENTIALS_H
+
+static const char* mySSID = "host";
+static const char* myPASSWORD = "host password";
+
+#endif
@@ -0,0 +1,43 @@
+// Host stand-in for esp_partition.h
+//
+// Flash is an array in memory with two OTA app partitions, ota_0 running.
+// As on flash, erasing sets whole sectors to 0xFF and writing can only clear
+// bits, so a write without an erase before it leaves a wrong image.
+
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  const char* label;
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* buffer, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* buffer, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+
+namespace host {
+  const size_t FLASH_SECTOR_SIZE = 4096;
+
+  // ota_0 and ota_1; the running one is otaPartitions[runningPartition]
+  extern const esp_partition_t otaPartitions[2];
+  extern int runningPartition;
+  // set by esp_ota_set_boot_partition()
+  extern const esp_partition_t* bootPartition;
+  extern unsigned long flashWrites;
+
+  // The bytes of a partition, for tests to fill and read back
+  uint8_t* partitionData(const esp_partition_t* partition);
+}
+
+#endif
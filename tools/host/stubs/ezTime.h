@@ -0,0 +1,31 @@
+// Host stand-in for ezTime
+//
+// Local time is the virtual clock plus host::clockStartS, so a test picks the
+// time of day the simulation starts at. events() calls are counted.
+
+#ifndef HOST_EZTIME_H
+#define HOST_EZTIME_H
+
+#include "Arduino.h"
+
+namespace host {
+  extern unsigned long clockStartS; // seconds since midnight at millis() == 0
+  extern unsigned long timeEvents;
+}
+
+class Timezone {
+public:
+  bool setLocation(const char* location) { return true; }
+  void setDefault() {}
+  String dateTime();
+};
+extern Timezone UTC;
+
+int hour();
+int minute();
+int second();
+void events();
+bool waitForSync(uint16_t timeout = 0);
+void setInterval(uint16_t seconds);
+
+#endif
@@ -0,0 +1,33 @@
+// Host stand-in for the mbedtls message digests; SHA-256 and HMAC-SHA256 only
+
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+  MBEDTLS_MD_NONE = 0,
+  MBEDTLS_MD_SHA256 = 6
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+typedef struct {
+  const mbedtls_md_info_t* info;
+  uint32_t state[8];
+  uint64_t length; // bytes hashed so far
+  uint8_t block[64];
+} mbedtls_md_context_t;
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type);
+void mbedtls_md_init(mbedtls_md_context_t* context);
+void mbedtls_md_free(mbedtls_md_context_t* context);
+int mbedtls_md_setup(mbedtls_md_context_t* context, const mbedtls_md_info_t* info, int hmac);
+int mbedtls_md_starts(mbedtls_md_context_t* context);
+int mbedtls_md_update(mbedtls_md_context_t* context, const unsigned char* input, size_t length);
+int mbedtls_md_finish(mbedtls_md_context_t* context, unsigned char* output);
+int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t keyLength,
+                    const unsigned char* input, size_t length, unsigned char* output);
+
+#endif
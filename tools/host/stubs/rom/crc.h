@@ -0,0 +1,10 @@
+// Host stand-in for the crc32 in the ESP32 ROM (zlib compatible)
+
+#ifndef HOST_ROM_CRC_H
+#define HOST_ROM_CRC_H
+
+#include <stdint.h>
+
+uint32_t crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length);
+
+#endif
@@ -0,0 +1,31 @@
+// Host stand-in for the inflater in the ESP32 ROM, backed by zlib
+//
+// Only inflates a whole raw deflate stream in one call, which is how
+// OTAStream.h uses it; no state is kept between calls.
+
+#ifndef HOST_ROM_MINIZ_H
+#define HOST_ROM_MINIZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+  uint32_t state;
+} tinfl_decompressor;
+
+typedef enum {
+  TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+#define tinfl_init(r) ((r)->state = 0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inSize, uint8_t* outStart,
+                              uint8_t* out, size_t* outSize, uint32_t flags);
+
+#endif
@@ -0,0 +1,528 @@
+// Word clock layout search
+//
+// Packs a vocabulary into a letter grid and prints the word tables in the
+// format wordclock.c uses ({ line index, start position index, length }).
+// Words run left to right and may share cells when the letters match, as long
+// as they are not ordered against each other. "before" rules keep the reading
+// order, e.g. "past" must end before any hour word starts.
+//
+// The search is a depth first branch and bound over the words in reading
+// order. The first levels of the tree are cut into tasks that the worker
+// threads take from a shared queue. The best layout found so far (fewest
+// cells with a letter, i.e. LEDs that need to be wired) bounds all threads.
+//
+// Build and run:
+//   g++ -O2 -std=c++17 -pthread tools/layout_search.cpp -o layout_search
+//   ./layout_search tools/layouts/wordclock.txt
+//   ./layout_search tools/layouts/wordclock_fine.txt --threads 8 --time 30
+//
+// Options:
+//   --grid ROWSxCOLS  override the grid size of the vocabulary file
+//   --budget N        only accept layouts with at most N letter cells
+//   --threads N       worker threads (default: all cores)
+//   --time S          stop after S seconds (default: 10)
+//   --first           stop at the first valid layout
+//
+// Vocabulary file:
+//   grid 10 11                 rows and cols
+//   word five five             name and letters; names like hours[1] form an array
+//   before past hours          past ends before every word of group hours starts
+//   before is five ten quarter the first name is before each of the others
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Word {
+  std::string name;
+  std::string letters;
+  std::string group;   // array name, empty for plain words
+  int groupIndex;
+  std::vector<int> preds;
+  int minNewCells;     // lower bound on the cells this word adds to any layout
+};
+
+struct Problem {
+  int rows;
+  int cols;
+  int budget;
+  std::vector<Word> words;
+  std::vector<int> order;           // reading order the words are placed in
+  std::vector<int> remainingBound;  // sum of minNewCells for order[depth..]
+};
+
+struct Candidate {
+  int pos;
+  int newCells;
+};
+
+struct Layout {
+  std::vector<char> grid;
+  std::vector<unsigned char> uses;
+  std::vector<int> start;
+  int occupied;
+};
+
+// Shared search state
+std::atomic<int> bestOccupied;
+std::atomic<bool> stopSearch(false);
+std::atomic<long long> totalNodes(0);
+std::mutex bestMutex;
+std::vector<int> bestStart;
+double firstSolutionSeconds = -1;
+Clock::time_point searchStart;
+bool stopAtFirst = false;
+Clock::time_point deadline;
+
+void fail(const std::string& message) {
+  fprintf(stderr, "error: %s\n", message.c_str());
+  exit(1);
+}
+
+std::vector<int> resolve(const Problem& problem, const std::string& name) {
+  std::vector<int> found;
+  for (size_t i = 0; i < problem.words.size(); i++) {
+    if (problem.words[i].name == name || problem.words[i].group == name) {
+      found.push_back(i);
+    }
+  }
+  if (found.empty()) {
+    fail("unknown word or group '" + name + "'");
+  }
+  return found;
+}
+
+Problem readProblem(const char* path) {
+  std::ifstream in(path);
+  if (!in) {
+    fail(std::string("cannot open ") + path);
+  }
+
+  Problem problem;
+  problem.rows = 0;
+  problem.cols = 0;
+  problem.budget = -1;
+  std::vector<std::vector<std::string> > rules;
+  std::string line;
+
+  while (std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string keyword;
+    if (!(tokens >> keyword)) {
+      continue;
+    }
+
+    if (keyword == "grid") {
+      tokens >> problem.rows >> problem.cols;
+    } else if (keyword == "word") {
+      Word word;
+      tokens >> word.name >> word.letters;
+      if (word.letters.empty()) {
+        fail("word without letters: " + line);
+      }
+      for (char& c : word.letters) {
+        c = toupper(c);
+      }
+      word.groupIndex = -1;
+      size_t bracket = word.name.find('[');
+      if (bracket != std::string::npos) {
+        word.group = word.name.substr(0, bracket);
+        word.groupIndex = atoi(word.name.c_str() + bracket + 1);
+      }
+      problem.words.push_back(word);
+    } else if (keyword == "before") {
+      std::vector<std::string> rule;
+      std::string name;
+      while (tokens >> name) {
+        rule.push_back(name);
+      }
+      if (rule.size() < 2) {
+        fail("before needs at least two words: " + line);
+      }
+      rules.push_back(rule);
+    } else {
+      fail("unknown keyword '" + keyword + "'");
+    }
+  }
+
+  for (const std::vector<std::string>& rule : rules) {
+    for (int first : resolve(problem, rule[0])) {
+      for (size_t i = 1; i < rule.size(); i++) {
+        for (int second : resolve(problem, rule[i])) {
+          problem.words[second].preds.push_back(first);
+        }
+      }
+    }
+  }
+  return problem;
+}
+
+// Reading order: topological order of the before rules. Of the words that
+// are free to go next the longest is placed first, so shorter words can
+// still be fitted inside it.
+void orderWords(Problem& problem) {
+  size_t n = problem.words.size();
+  std::vector<int> waiting(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    waiting[i] = problem.words[i].preds.size();
+  }
+
+  std::vector<bool> placed(n, false);
+  while (problem.order.size() < n) {
+    size_t next = n;
+    for (size_t i = 0; i < n; i++) {
+      if (!placed[i] && waiting[i] == 0
+          && (next == n || problem.words[i].letters.size() > problem.words[next].letters.size())) {
+        next = i;
+      }
+    }
+    if (next == n) {
+      fail("before rules contain a cycle");
+    }
+    placed[next] = true;
+    problem.order.push_back(next);
+    for (size_t i = 0; i < n; i++) {
+      for (int pred : problem.words[i].preds) {
+        if (pred == (int) next) {
+          waiting[i]--;
+        }
+      }
+    }
+  }
+}
+
+// A word can only share cells with another word at its start, its end, or
+// by containing it, since all words run along rows.
+void computeBounds(Problem& problem) {
+  for (Word& word : problem.words) {
+    const std::string& w = word.letters;
+    int len = w.size();
+    int prefix = 0;
+    int suffix = 0;
+    int contained = 0;
+    bool inside = false;
+
+    for (const Word& other : problem.words) {
+      const std::string& o = other.letters;
+      if (&other == &word) {
+        continue;
+      }
+      if (o.size() >= w.size() && o.find(w) != std::string::npos) {
+        inside = true;
+        break;
+      }
+      if (o.size() < w.size() && w.find(o) != std::string::npos) {
+        contained += o.size();
+      }
+      for (int k = std::min(len, (int) o.size()) - 1; k > 0; k--) {
+        if (w.compare(0, k, o, o.size() - k, k) == 0) {
+          prefix = std::max(prefix, k);
+        }
+        if (w.compare(len - k, k, o, 0, k) == 0) {
+          suffix = std::max(suffix, k);
+        }
+      }
+    }
+    word.minNewCells = inside ? 0 : std::max(0, len - prefix - suffix - contained);
+  }
+
+  problem.remainingBound.assign(problem.order.size() + 1, 0);
+  for (int depth = problem.order.size() - 1; depth >= 0; depth--) {
+    problem.remainingBound[depth] = problem.remainingBound[depth + 1]
+                                  + problem.words[problem.order[depth]].minNewCells;
+  }
+}
+
+Layout emptyLayout(const Problem& problem) {
+  Layout layout;
+  layout.grid.assign(problem.rows * problem.cols, 0);
+  layout.uses.assign(problem.rows * problem.cols, 0);
+  layout.start.assign(problem.words.size(), -1);
+  layout.occupied = 0;
+  return layout;
+}
+
+// Positions for the word at this depth that keep the reading order, fit the
+// letters already on the grid and can still beat the bound, best first.
+void candidates(const Problem& problem, const Layout& layout, int depth, int bound, std::vector<Candidate>& out) {
+  const Word& word = problem.words[problem.order[depth]];
+  int len = word.letters.size();
+  int earliest = 0;
+  for (int pred : word.preds) {
+    earliest = std::max(earliest, layout.start[pred] + (int) problem.words[pred].letters.size());
+  }
+
+  out.clear();
+  int cells = problem.rows * problem.cols;
+  for (int pos = earliest; pos + len <= cells; pos++) {
+    int col = pos % problem.cols;
+    if (col + len > problem.cols) {
+      pos += problem.cols - col - 1; // next row
+      continue;
+    }
+
+    int newCells = 0;
+    bool fits = true;
+    for (int i = 0; i < len && fits; i++) {
+      char c = layout.grid[pos + i];
+      if (c == 0) {
+        newCells++;
+      } else if (c != word.letters[i]) {
+        fits = false;
+      }
+    }
+    if (fits && layout.occupied + newCells + problem.remainingBound[depth + 1] < bound) {
+      out.push_back({ pos, newCells });
+    }
+  }
+
+  std::stable_sort(out.begin(), out.end(), [](const Candidate& a, const Candidate& b) {
+    return a.newCells < b.newCells;
+  });
+}
+
+void place(const Problem& problem, Layout& layout, int wordIndex, int pos) {
+  const std::string& letters = problem.words[wordIndex].letters;
+  for (size_t i = 0; i < letters.size(); i++) {
+    if (layout.uses[pos + i]++ == 0) {
+      layout.grid[pos + i] = letters[i];
+      layout.occupied++;
+    }
+  }
+  layout.start[wordIndex] = pos;
+}
+
+void unplace(const Problem& problem, Layout& layout, int wordIndex) {
+  int pos = layout.start[wordIndex];
+  for (size_t i = 0; i < problem.words[wordIndex].letters.size(); i++) {
+    if (--layout.uses[pos + i] == 0) {
+      layout.grid[pos + i] = 0;
+      layout.occupied--;
+    }
+  }
+  layout.start[wordIndex] = -1;
+}
+
+void recordSolution(const Layout& layout) {
+  std::lock_guard<std::mutex> lock(bestMutex);
+  if (layout.occupied >= bestOccupied.load()) {
+    return;
+  }
+  bestOccupied.store(layout.occupied);
+  bestStart = layout.start;
+
+  double seconds = std::chrono::duration<double>(Clock::now() - searchStart).count();
+  if (firstSolutionSeconds < 0) {
+    firstSolutionSeconds = seconds;
+  }
+  fprintf(stderr, "  %.3f s: layout with %d letter cells\n", seconds, layout.occupied);
+  if (stopAtFirst) {
+    stopSearch.store(true);
+  }
+}
+
+void search(const Problem& problem, Layout& layout, int depth, long long& nodes) {
+  if (stopSearch.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if ((++nodes & 0xFFFF) == 0) {
+    totalNodes.fetch_add(0x10000, std::memory_order_relaxed);
+    if (Clock::now() > deadline) {
+      stopSearch.store(true);
+      return;
+    }
+  }
+  if (depth == (int) problem.order.size()) {
+    recordSolution(layout);
+    return;
+  }
+
+  std::vector<Candidate> options;
+  candidates(problem, layout, depth, bestOccupied.load(std::memory_order_relaxed), options);
+  int wordIndex = problem.order[depth];
+  for (const Candidate& option : options) {
+    if (layout.occupied + option.newCells + problem.remainingBound[depth + 1] >= bestOccupied.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    place(problem, layout, wordIndex, option.pos);
+    search(problem, layout, depth + 1, nodes);
+    unplace(problem, layout, wordIndex);
+    if (stopSearch.load(std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+// Split the top of the tree into prefixes (start positions of the first words)
+std::vector<std::vector<int> > makeTasks(const Problem& problem, size_t wanted) {
+  std::vector<std::vector<int> > tasks(1);
+  std::vector<Candidate> options;
+
+  for (size_t depth = 0; depth < problem.order.size() && tasks.size() < wanted; depth++) {
+    std::vector<std::vector<int> > next;
+    for (const std::vector<int>& prefix : tasks) {
+      Layout layout = emptyLayout(problem);
+      for (size_t i = 0; i < prefix.size(); i++) {
+        place(problem, layout, problem.order[i], prefix[i]);
+      }
+      candidates(problem, layout, depth, bestOccupied.load(), options);
+      for (const Candidate& option : options) {
+        next.push_back(prefix);
+        next.back().push_back(option.pos);
+      }
+    }
+    if (next.empty()) {
+      break;
+    }
+    tasks.swap(next);
+  }
+  return tasks;
+}
+
+void printLayout(const Problem& problem) {
+  std::vector<char> grid(problem.rows * problem.cols, '.');
+  for (size_t i = 0; i < problem.words.size(); i++) {
+    for (size_t j = 0; j < problem.words[i].letters.size(); j++) {
+      grid[bestStart[i] + j] = problem.words[i].letters[j];
+    }
+  }
+
+  printf("// Grid %dx%d, %d letter cells ('.' is filler)\n", problem.rows, problem.cols, bestOccupied.load());
+  for (int row = 0; row < problem.rows; row++) {
+    printf("//   %.*s\n", problem.cols, &grid[row * problem.cols]);
+  }
+  printf("\n// Words\n// Format: { line index, start position index, length }\n");
+
+  std::map<std::string, std::vector<int> > groups;
+  for (size_t i = 0; i < problem.words.size(); i++) {
+    const Word& word = problem.words[i];
+    if (!word.group.empty()) {
+      groups[word.group].push_back(i);
+      continue;
+    }
+    std::string lower = word.letters;
+    for (char& c : lower) {
+      c = tolower(c);
+    }
+    std::string declaration = "const int w_" + word.name + "[3] =";
+    printf("%-27s { %d,  %d,  strlen(\"%s\") };\n", declaration.c_str(),
+           bestStart[i] / problem.cols, bestStart[i] % problem.cols, lower.c_str());
+  }
+
+  for (const auto& group : groups) {
+    int first = problem.words[group.second.front()].groupIndex;
+    int size = problem.words[group.second.back()].groupIndex + 1;
+    printf("\nconst int w_%s[%d][3] = {\n", group.first.c_str(), size);
+    for (int index = 0; index < size; index++) {
+      int wordIndex = -1;
+      for (int i : group.second) {
+        if (problem.words[i].groupIndex == index) {
+          wordIndex = i;
+        }
+      }
+      const char* separator = (index + 1 < size) ? "," : "";
+      if (wordIndex < 0) {
+        printf("  { -1,  -1,  -1 }%s%s\n", separator, index < first ? " // filler element so index matches position" : "");
+        continue;
+      }
+      std::string lower = problem.words[wordIndex].letters;
+      for (char& c : lower) {
+        c = tolower(c);
+      }
+      printf("  { %d,  %d,  strlen(\"%s\") }%s\n", bestStart[wordIndex] / problem.cols,
+             bestStart[wordIndex] % problem.cols, lower.c_str(), separator);
+    }
+    printf("};\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s VOCABULARY [--grid ROWSxCOLS] [--budget N] [--threads N] [--time S] [--first]\n", argv[0]);
+    return 1;
+  }
+
+  Problem problem = readProblem(argv[1]);
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  double seconds = 10;
+
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--grid" && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &problem.rows, &problem.cols) != 2) {
+        fail("--grid expects ROWSxCOLS");
+      }
+    } else if (arg == "--budget" && i + 1 < argc) {
+      problem.budget = atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--time" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--first") {
+      stopAtFirst = true;
+    } else {
+      fail("unknown option " + arg);
+    }
+  }
+  if (problem.rows <= 0 || problem.cols <= 0) {
+    fail("no grid size given");
+  }
+
+  orderWords(problem);
+  computeBounds(problem);
+
+  int cells = problem.rows * problem.cols;
+  bestOccupied.store((problem.budget >= 0 ? std::min(problem.budget, cells) : cells) + 1);
+  searchStart = Clock::now();
+  deadline = searchStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+  std::vector<std::vector<int> > tasks = makeTasks(problem, threads * 64);
+  std::atomic<size_t> nextTask(0);
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&]() {
+      long long nodes = 0;
+      Layout layout = emptyLayout(problem);
+      for (size_t task = nextTask++; task < tasks.size() && !stopSearch.load(); task = nextTask++) {
+        const std::vector<int>& prefix = tasks[task];
+        for (size_t i = 0; i < prefix.size(); i++) {
+          place(problem, layout, problem.order[i], prefix[i]);
+        }
+        search(problem, layout, prefix.size(), nodes);
+        for (size_t i = prefix.size(); i-- > 0;) {
+          unplace(problem, layout, problem.order[i]);
+        }
+      }
+      totalNodes.fetch_add(nodes & 0xFFFF);
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - searchStart).count();
+  bool complete = !stopSearch.load();
+  fprintf(stderr, "%d threads, %zu tasks, %lld nodes in %.3f s (%.0f nodes/s), first layout after %.3f s%s\n",
+          threads, tasks.size(), totalNodes.load(), elapsed, totalNodes.load() / std::max(elapsed, 1e-9),
+          firstSolutionSeconds, complete ? ", search complete" : "");
+
+  if (bestStart.empty()) {
+    fprintf(stderr, "no layout found\n");
+    return 2;
+  }
+  printLayout(problem);
+  return 0;
+}
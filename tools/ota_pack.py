@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Build and send streaming OTA images for the wordclock (see OTAStream.h).
+
+  ota_pack.py pack firmware.bin -o firmware.wco [--base running.bin]
+  ota_pack.py send firmware.wco wordclock.local [--port 3233] [--secret SECRET]
+
+An image is a 48 byte header followed by one record per 4096 byte chunk, in
+the same format the device reads from the socket. With --base, chunks inside
+the base image are xor'd with it before compressing, which makes unchanged
+code compress to almost nothing. The xor is per sector, so it only helps
+while code stays at the same address: after an insertion the chunks behind
+it gain nothing and are sent deflated on their own. send signs the header with the OTA secret
+(the password in credentials.h, or $WORDCLOCK_OTA_SECRET) and the nonce the
+device sends, and reconnects and resumes from the chunk the device asks for
+when the link drops.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = b"WCO2"
+HEADER_SIZE = 48
+NONCE_SIZE = 16
+CHUNK_SIZE = 4096
+DEFLATED = 0x01
+DELTA = 0x02
+ERROR = 0xFFFFFFFF
+DONE = 0xFFFFFFFE
+
+
+def deflate(data):
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+    return compressor.compress(data) + compressor.flush()
+
+
+def pack(image, base):
+    header = MAGIC + struct.pack("<III", len(image), len(base), zlib.crc32(base) if base else 0)
+    header += hashlib.sha256(image).digest()
+    records = []
+    for index, offset in enumerate(range(0, len(image), CHUNK_SIZE)):
+        chunk = image[offset:offset + CHUNK_SIZE]
+        flags, data = 0, chunk
+
+        candidates = [(DEFLATED, deflate(chunk))]
+        if offset + len(chunk) <= len(base):
+            delta = bytes(a ^ b for a, b in zip(chunk, base[offset:offset + len(chunk)]))
+            candidates.append((DEFLATED | DELTA, deflate(delta)))
+        for candidate_flags, candidate in candidates:
+            if len(candidate) < len(data):
+                flags, data = candidate_flags, candidate
+
+        records.append(struct.pack("<IBHI", index, flags, len(data), zlib.crc32(chunk)) + data)
+    return header, records
+
+
+def read_image(path):
+    with open(path, "rb") as f:
+        blob = f.read()
+    if blob[:4] != MAGIC:
+        sys.exit("%s is not a packed image" % path)
+    header, records, offset = blob[:HEADER_SIZE], [], HEADER_SIZE
+    while offset < len(blob):
+        length = struct.unpack_from("<H", blob, offset + 5)[0]
+        records.append(blob[offset:offset + 11 + length])
+        offset += 11 + length
+    return header, records
+
+
+def receive_exact(sock, length):
+    reply = b""
+    while len(reply) < length:
+        data = sock.recv(length - len(reply))
+        if not data:
+            raise ConnectionError("connection closed")
+        reply += data
+    return reply
+
+
+def receive_u32(sock):
+    return struct.unpack("<I", receive_exact(sock, 4))[0]
+
+
+def sign(header, nonce, secret):
+    return hmac.new(secret.encode(), nonce + header, hashlib.sha256).digest()
+
+
+def send(header, records, host, port, secret, retries, retry_delay=2):
+    for attempt in range(retries + 1):
+        try:
+            with socket.create_connection((host, port), timeout=30) as sock:
+                nonce = receive_exact(sock, NONCE_SIZE)
+                sock.sendall(header + sign(header, nonce, secret))
+                next_chunk = receive_u32(sock)
+                if next_chunk == ERROR:
+                    sys.exit("device rejected the image header, check the OTA secret")
+                print("resuming at chunk %d of %d" % (next_chunk, len(records)))
+
+                while next_chunk < len(records):
+                    sock.sendall(records[next_chunk])
+                    reply = receive_u32(sock)
+                    if reply == ERROR:
+                        raise ConnectionError("device rejected chunk %d" % next_chunk)
+                    next_chunk = reply
+                    print("\r%d/%d" % (min(next_chunk, len(records)), len(records)), end="", flush=True)
+
+                if next_chunk != DONE and receive_u32(sock) != DONE:
+                    sys.exit("\ndevice did not accept the image")
+                print("\ndone")
+                return
+        except (OSError, ConnectionError) as e:
+            if attempt == retries:
+                print("\n%s" % e)
+                break
+            print("\n%s, retrying (%d/%d)" % (e, attempt + 1, retries))
+            time.sleep(retry_delay)
+    sys.exit("giving up")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    pack_parser = commands.add_parser("pack")
+    pack_parser.add_argument("firmware")
+    pack_parser.add_argument("-o", "--output", required=True)
+    pack_parser.add_argument("--base", help="firmware currently running on the device")
+
+    send_parser = commands.add_parser("send")
+    send_parser.add_argument("image")
+    send_parser.add_argument("host")
+    send_parser.add_argument("--port", type=int, default=3233)
+    send_parser.add_argument("--retries", type=int, default=10)
+    send_parser.add_argument("--secret", default=os.environ.get("WORDCLOCK_OTA_SECRET"),
+                             help="OTA secret, defaults to $WORDCLOCK_OTA_SECRET")
+
+    args = parser.parse_args()
+
+    if args.command == "pack":
+        with open(args.firmware, "rb") as f:
+            image = f.read()
+        base = b""
+        if args.base:
+            with open(args.base, "rb") as f:
+                base = f.read()
+        header, records = pack(image, base)
+        with open(args.output, "wb") as f:
+            f.write(header)
+            for record in records:
+                f.write(record)
+        packed = len(header) + sum(len(r) for r in records)
+        print("%d bytes -> %d bytes (%.1f%%)" % (len(image), packed, 100.0 * packed / len(image)))
+    else:
+        if not args.secret:
+            sys.exit("send needs --secret or $WORDCLOCK_OTA_SECRET")
+        header, records = read_image(args.image)
+        send(header, records, args.host, args.port, args.secret, args.retries)
+
+
+if __name__ == "__main__":
+    main()
@@ -132,7 +132,7 @@ const int w_minutes[20][3] = {
   { 0,  6,  6 }  // twenty
 };
 
-const int w_hours[12][3] = {
+const int w_hours[11][3] = {
   { 9,  0,  3 }, // one
   { 9,  3,  3 }, // two
   { 10, 0,  5 }, // three
@@ -143,7 +143,7 @@ const int w_hours[12][3] = {
   { 10, 9,  5 }, // eight
   { 12, 2,  4 }, // nine
   { 11,10,  3 }, // ten
-  { 12, 8,  4 }, // eleven
+  { 12, 8,  6 }, // eleven
 };
 
 // Touch
@@ -307,17 +307,14 @@ void showTime() {
     
   } 
   
-  if (hour == 0) {
+  // Hours, "to" counts towards the next one
+  hourToDisplay %= 24;
+  if (hourToDisplay == 0) {
     displayWord(w_midnight);
-  } else if (hour == 12) {
+  } else if (hourToDisplay == 12) {
     displayWord(w_noon);
   } else {
-    // Hours
-    if (hourToDisplay < 12) {
-      displayWord(w_hours[hourToDisplay - 1]);
-    } else {
-      displayWord(w_hours[hourToDisplay - 13]);
-    }
+    displayWord(w_hours[(hourToDisplay % 12) - 1]);
   }
 
   // Update display
@@ -350,7 +347,7 @@ boolean debounce(boolean value, boolean* store) {
 void displayWord(const int word[3]){
   int row = word[0];
   int col = word[1];
-  int length = word[3];
+  int length = word[2];
 
   for (int i = 0; i < length; i++) {
     int ledNum = convertFrom2DTo1D(row, col + i);
@@ -6,14 +6,36 @@
 #include <FastLED.h>
 #include <WiFi.h>
 #include <ezTime.h>
+#include <Preferences.h>
 #include <credentials.h>
 #include "OTATelnetStream.h"
+#include "OTAStream.h"
+#include "LedGrid.h"
+#include "MotionQueue.h"
 
 const int PIN_LED_DATA = 15;
 const int PIN_LED_CLOCK = 32;
 const int PIN_LIGHT = 33;
 const int PIN_MOTION = 27;
 
+// Everything logged from the loop goes through Log so the loop statistics
+// can count it
+class CountingStream : public Print {
+public:
+  unsigned long bytes = 0;
+
+  size_t write(uint8_t c) override {
+    bytes++;
+    return TelnetStream.write(c);
+  }
+
+  size_t write(const uint8_t* buffer, size_t size) override {
+    bytes += size;
+    return TelnetStream.write(buffer, size);
+  }
+};
+CountingStream Log;
+
 // NTP clock server
 Timezone localTimezone;
 const char* LOCAL_TIMEZONE_LOCATION = "America/New_York";
@@ -23,12 +45,31 @@ const int NUM_COLS = 11;
 const int NUM_ROWS = 10;
 const int NUM_MINUTES = 4; // LEDs for fine minute granularity
 const int NUM_LEDS = (NUM_COLS * NUM_ROWS) + NUM_MINUTES;
-const boolean SNAKE = true; // snake LEDs for cleaner wiring; odd numbered rows are reversed
-const int START_POS = 0;
+const int MINUTES_ROW = NUM_ROWS; // fine minute LEDs are addressed as an extra row below the grid
+const int GRID_ROWS = NUM_ROWS + 1;
+
+// Tiles wiring the grid, see LedGrid.h. Parallel strips get their own
+// FastLED.addLeds() in setup().
+const Tile TILES[] = {
+  { 0,           0, NUM_ROWS, NUM_COLS,    0,                   true,  false, false, false },
+  { MINUTES_ROW, 0, 1,        NUM_MINUTES, NUM_COLS * NUM_ROWS, false, false, false, false }
+};
+const int NUM_TILES = sizeof(TILES) / sizeof(TILES[0]);
 
 CRGB leds[NUM_LEDS];
 boolean leds_buffer[NUM_LEDS];
 
+// Precomputed grid position -> LED index, -1 where no LED is wired
+int16_t ledMap[GRID_ROWS][NUM_COLS];
+
+// LEDs set in leds_buffer for the next frame, and LEDs lit in the current
+// frame, so a frame update only touches LEDs that change
+int16_t litLeds[NUM_LEDS];
+int16_t shownLeds[NUM_LEDS];
+const int FRAME_MASK_WORDS = (NUM_LEDS + 31) / 32;
+uint32_t frameMask[FRAME_MASK_WORDS];
+LedFrame frame = { NUM_LEDS, leds, leds_buffer, litLeds, 0, shownLeds, 0, frameMask };
+
 // Brightness and motion
 boolean readManualOverrideBrightness = false;
 int manualOverrideBrightness = -1;
@@ -46,7 +87,104 @@ boolean lastMotion;
 const long NO_MOTION_THRESHOLD_DAY_MS = 15 * 60 * 1000; // 5 minutes
 const long NO_MOTION_THRESHOLD_NIGHT_MS = 5 * 60 * 1000; // 2 minutes
 unsigned long lastMotionDetectedMs;
-boolean logLedSleep = true;
+MotionQueue motionQueue; // filled by onMotionEdge(), see MotionQueue.h
+
+// Power states, from most to least awake. Each state has its own CPU clock,
+// WiFi power save mode and task intervals; see powerProfiles. Modem sleep
+// (WIFI_PS_MIN_MODEM) is the arduino-esp32 default and stays on while awake;
+// max modem sleep skips more DTIM beacons once nobody is looking.
+enum PowerState {
+  POWER_ACTIVE,
+  POWER_DIMMED,       // about to turn the display off
+  POWER_DISPLAY_OFF,
+  POWER_DEEP_IDLE     // display off for a long time
+};
+typedef struct PowerProfiles {
+  const char* name;
+  uint32_t cpuMhz;      // 80 MHz is the lowest clock WiFi still works at
+  wifi_ps_type_t wifiPowerSave;
+  unsigned long showTimeInterval;
+  unsigned long readLightInterval;
+  unsigned long brightnessInterval;
+  unsigned long loopDelayMs;
+} PowerProfile;
+const PowerProfile powerProfiles[] = {
+  { "active",      240, WIFI_PS_MIN_MODEM, 1000,  250,   2000,  0   },
+  { "dimmed",      240, WIFI_PS_MIN_MODEM, 1000,  250,   2000,  0   },
+  { "display off", 80,  WIFI_PS_MAX_MODEM, 10000, 2000,  10000, 50  },
+  { "deep idle",   80,  WIFI_PS_MAX_MODEM, 30000, 10000, 30000, 200 }
+};
+const long DIM_BEFORE_OFF_MS = 60 * 1000;
+const long DEEP_IDLE_AFTER_MS = 30 * 60 * 1000;
+PowerState powerState = POWER_ACTIVE;
+
+// Tasks
+typedef struct Tasks {
+  const char* name;
+  unsigned long previous;
+  unsigned long interval;
+  void (*function)();
+} Task;
+const int TASK_SHOW_TIME = 0;
+const int TASK_EVENTS = 1;
+const int TASK_POWER_STATE = 2;
+const int TASK_READ_LIGHT = 3;
+const int TASK_BRIGHTNESS = 4;
+const int TASK_SERIAL_MENU = 5;
+const int TASK_LOOP_STATS = 6;
+const int TASK_LED_USAGE = 7;
+const int TASK_SCROLL_TEXT = 8;
+const int NUM_TASKS = 9;
+Task tasks[NUM_TASKS];
+
+// Stall watchdog. loop() beats a heartbeat and notes every task it enters in
+// a ring kept in RTC memory, which survives a soft reset. A watchdog task on
+// the other core records which task the loop stalled in when the heartbeat
+// stops, and restarts the clock if it does not come back. It only writes RTC
+// memory: a stall the loop recovers from is reported by loop(), one it does
+// not by the next boot. The WiFi connect and time sync in setup() are watched
+// like tasks.
+const int LOOP_TASK = -1; // loop() itself, outside of any task
+const int SETUP_WIFI = -2;
+const int SETUP_TIME_SYNC = -3;
+const int STALL_RING_SIZE = 16;
+const uint32_t STALL_RECORD_MAGIC = 0x57445431;
+const unsigned long STALL_CHECK_MS = 250;
+const unsigned long STALL_THRESHOLD_MS = 5000;
+const unsigned long STALL_RESTART_MS = 60000;
+typedef struct TaskEntries {
+  int8_t task;
+  uint32_t ms;
+} TaskEntry;
+typedef struct StallRecords {
+  uint32_t magic;
+  boolean stalled;
+  int8_t task;          // task running when the loop stalled
+  uint32_t stalledMs;   // how long it had been running
+  uint32_t ringIndex;
+  TaskEntry ring[STALL_RING_SIZE];
+} StallRecord;
+RTC_NOINIT_ATTR StallRecord stallRecord;
+StallRecord bootStallRecord; // stallRecord as this boot found it
+volatile unsigned long heartbeatMs;
+volatile int currentTask = LOOP_TASK;
+volatile unsigned long currentTaskStartMs;
+
+// Loop statistics, reported and reset once a day. tools/host/loop_bench.cpp
+// runs a simulated day against the limits in loop_bench_thresholds.txt.
+typedef struct LoopStatistics {
+  unsigned long startMs;
+  unsigned long loops;
+  unsigned long shows;
+  unsigned long long ledBytes;
+  unsigned long logBytes;       // Log.bytes when the statistics were reset
+  unsigned long maxLoopUs;
+  unsigned long long busyUs;    // time spent in tasks
+} LoopStats;
+LoopStats loopStats;
+const unsigned long LOOP_STATS_PERIOD_MS = 24UL * 60 * 60 * 1000;
+// SK9822: 4 byte start frame, 4 bytes per LED, 4 byte reset frame and an end frame of half a bit per LED
+const unsigned long LED_FRAME_BYTES = 4 + (NUM_LEDS * 4) + 4 + ((NUM_LEDS + 15) / 16);
 
 const boolean DISPLAY_IT_IS = false;
 
@@ -81,29 +219,128 @@ const int w_hours[NUM_HOURS + 1][3] = {
 };
 
 // special ordering because of wiring
-const int w_minutes[NUM_MINUTES + 1][3] = {
-//  { -1,  -1,  -1 }, // filler element so minute matches index position
+const int w_minutes[NUM_MINUTES][3] = {
   { 10,  3,  1 },
   { 10,  2,  1 },
   { 10,  1,  1 },
   { 10,  0,  1 }
 };
-// used to fairly distribute led usage when displaying minute granularity
-int minuteIndex = 1;
+// Order the fine minute LEDs are lit in, least worn first, so the LED that
+// has been lit least stays on longest. Picked again every five minutes.
+int minuteOrder[NUM_MINUTES] = { 0, 1, 2, 3 };
+
+// LED wear: cumulative on-time x brightness per LED, in brightness x ms.
+// frameMask has a bit per LED in the current frame so accounting only visits
+// lit LEDs. Stored in NVS in brightness x minutes to keep it small.
+uint64_t ledUsage[NUM_LEDS];
+unsigned long lastUsageMs = 0;
+uint8_t lastUsageBrightness = 0;
+unsigned long long litBrightnessMs = 0; // sum over all LEDs, for power estimates
+const unsigned long USAGE_UNIT_MS = 60000;
+Preferences ledUsagePrefs;
+
+// LEDs skipped by displayWord() because the word runs off the grid, checked
+// by tools/host/clock_verify.cpp
+int invalidWordLeds = 0;
+
+// Scrolling text
+// Glyphs are 5 columns of 7 rows, one byte per column with the top row in
+// bit 0. '*' is drawn as a degree sign. Lower case is shown as upper case.
+const int GLYPH_WIDTH = 5;
+const int GLYPH_HEIGHT = 7;
+const char GLYPH_CHARS[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ!-.:?%+/*";
+const uint8_t GLYPHS[][GLYPH_WIDTH] PROGMEM = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E }, // 0
+  { 0x00, 0x42, 0x7F, 0x40, 0x00 }, // 1
+  { 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+  { 0x21, 0x41, 0x45, 0x4B, 0x31 }, // 3
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 4
+  { 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+  { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // 6
+  { 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+  { 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+  { 0x06, 0x49, 0x49, 0x29, 0x1E }, // 9
+  { 0x7E, 0x11, 0x11, 0x11, 0x7E }, // A
+  { 0x7F, 0x49, 0x49, 0x49, 0x36 }, // B
+  { 0x3E, 0x41, 0x41, 0x41, 0x22 }, // C
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C }, // D
+  { 0x7F, 0x49, 0x49, 0x49, 0x41 }, // E
+  { 0x7F, 0x09, 0x09, 0x09, 0x01 }, // F
+  { 0x3E, 0x41, 0x49, 0x49, 0x7A }, // G
+  { 0x7F, 0x08, 0x08, 0x08, 0x7F }, // H
+  { 0x00, 0x41, 0x7F, 0x41, 0x00 }, // I
+  { 0x20, 0x40, 0x41, 0x3F, 0x01 }, // J
+  { 0x7F, 0x08, 0x14, 0x22, 0x41 }, // K
+  { 0x7F, 0x40, 0x40, 0x40, 0x40 }, // L
+  { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // M
+  { 0x7F, 0x04, 0x08, 0x10, 0x7F }, // N
+  { 0x3E, 0x41, 0x41, 0x41, 0x3E }, // O
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 }, // P
+  { 0x3E, 0x41, 0x51, 0x21, 0x5E }, // Q
+  { 0x7F, 0x09, 0x19, 0x29, 0x46 }, // R
+  { 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+  { 0x01, 0x01, 0x7F, 0x01, 0x01 }, // T
+  { 0x3F, 0x40, 0x40, 0x40, 0x3F }, // U
+  { 0x1F, 0x20, 0x40, 0x20, 0x1F }, // V
+  { 0x3F, 0x40, 0x38, 0x40, 0x3F }, // W
+  { 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+  { 0x07, 0x08, 0x70, 0x08, 0x07 }, // Y
+  { 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+  { 0x00, 0x00, 0x5F, 0x00, 0x00 }, // !
+  { 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+  { 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+  { 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+  { 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+  { 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+  { 0x08, 0x08, 0x3E, 0x08, 0x08 }, // +
+  { 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+  { 0x00, 0x06, 0x09, 0x09, 0x06 }  // degree
+};
+const int SCROLL_TOP_ROW = (NUM_ROWS - GLYPH_HEIGHT) / 2;
+const unsigned long SCROLL_STEP_MS = 100;
+const int MESSAGE_MAX_LENGTH = 64;
+const int MESSAGE_QUEUE_SIZE = 4;
+// one column per glyph column and a blank column between glyphs, then a
+// screen of blank columns so the message scrolls out
+const int SCROLL_MAX_COLUMNS = (MESSAGE_MAX_LENGTH * (GLYPH_WIDTH + 1)) + NUM_COLS;
+// rows on screen are packed 32 columns to a word, the rightmost column in
+// bit 0 of word 0; SCROLL_TOP_WORD_MASK keeps the last word to the grid
+const int SCROLL_ROW_WORDS = (NUM_COLS + 31) / 32;
+const int SCROLL_TOP_WORD_COLS = NUM_COLS - ((SCROLL_ROW_WORDS - 1) * 32);
+const uint32_t SCROLL_TOP_WORD_MASK = (SCROLL_TOP_WORD_COLS < 32) ? ((1UL << SCROLL_TOP_WORD_COLS) - 1) : 0xFFFFFFFF;
+
+char messageQueue[MESSAGE_QUEUE_SIZE][MESSAGE_MAX_LENGTH + 1];
+int messageQueueHead = 0;
+int messageQueueCount = 0;
+boolean readScrollMessage = false;
+
+// Columns of the message being scrolled, and the rows on screen
+uint8_t scrollColumns[SCROLL_MAX_COLUMNS];
+int numScrollColumns = 0;
+int scrollPosition = 0;
+uint32_t scrollRows[GLYPH_HEIGHT][SCROLL_ROW_WORDS];
+boolean scrolling = false;
 
 void serialMenu() {
   if (Serial.peek() == 10) { // ignore new line
     Serial.read();
   }
   if (Serial.available() > 0) {
-    if (readManualOverrideBrightness) {
+    if (readScrollMessage) {
+      String message = Serial.readStringUntil('\n');
+      message.trim();
+      queueMessage(message.c_str());
+      readScrollMessage = false;
+      printMenu();
+    } else if (readManualOverrideBrightness) {
       if (Serial.available()) {
         int val = Serial.parseInt();
         if (val < -1 || val > 255) {
-          TelnetStream.println("[ERROR] Brightness must be between -1 and 255");
+          Log.println("[ERROR] Brightness must be between -1 and 255");
         } else {
-          TelnetStream.print("Brightness set to ");
-          TelnetStream.println(val, DEC);
+          Log.print("Brightness set to ");
+          Log.println(val, DEC);
           manualOverrideBrightness = val;
         }
         readManualOverrideBrightness = false;
@@ -112,25 +349,37 @@ void serialMenu() {
     } else {
       int in = Serial.read();
       if (in == 49) { // ascii 1 = byte 49
-        TelnetStream.println("You entered [1]");
-        TelnetStream.println("  Enter brightness (0-255):");
+        Log.println("You entered [1]");
+        Log.println("  Enter brightness (0-255):");
         readManualOverrideBrightness = true;
       } else if (in == 50) {
-        TelnetStream.println("You entered [2]");
-        TelnetStream.print("  Brightness: ");
-        TelnetStream.println(manualOverrideBrightness, DEC);
+        Log.println("You entered [2]");
+        Log.print("  Brightness: ");
+        Log.println(manualOverrideBrightness, DEC);
         printMenu();
       } else if (in == 51) {
-        TelnetStream.println("You entered [3]");
-        TelnetStream.println("  Beginning simulation.");
+        Log.println("You entered [3]");
+        Log.println("  Beginning simulation.");
         
         simulateClock();
         printMenu();
+      } else if (in == 52) {
+        Log.println("You entered [4]");
+        reportLoopStats();
+        printMenu();
+      } else if (in == 53) {
+        Log.println("You entered [5]");
+        printLedUsage();
+        printMenu();
+      } else if (in == 54) {
+        Log.println("You entered [6]");
+        Log.println("  Enter message:");
+        readScrollMessage = true;
       } else if (in == 10) {
 
       } else {
-        TelnetStream.print("[ERROR] Invalid input: ");
-        TelnetStream.println(in);
+        Log.print("[ERROR] Invalid input: ");
+        Log.println(in);
         printMenu();
       }
     }
@@ -138,18 +387,27 @@ void serialMenu() {
 }
 
 void showTime() {
+  if (scrolling) {
+    return;
+  }
   showTime(hour(), minute());
 }
 
 void showTime(int hour, int minute) {
-  int hourToDisplay = hour;
-  
   // DEBUG
-  TelnetStream.print("[DEBUG] ");
-  TelnetStream.print(hour, DEC);
-  TelnetStream.print(':');
-  TelnetStream.println(minute, DEC);
-  
+  Log.print("[DEBUG] ");
+  Log.print(hour, DEC);
+  Log.print(':');
+  Log.println(minute, DEC);
+
+  composeTime(hour, minute);
+  updateDisplayAndClearBuffer();
+}
+
+// Set the words for a time in leds_buffer without touching the display
+void composeTime(int hour, int minute) {
+  int hourToDisplay = hour;
+
   // "IT IS"
   if (DISPLAY_IT_IS) {
     displayWord(w_it);
@@ -201,8 +459,8 @@ void showTime(int hour, int minute) {
   			displayWord(w_five);
         break;
   		default:
-  			TelnetStream.print("[ERROR] Invalid floorMinute: ");
-        TelnetStream.println(floorMinute, DEC);
+  			Log.print("[ERROR] Invalid floorMinute: ");
+        Log.println(floorMinute, DEC);
   	}
  
     if (minute <= 34) {
@@ -224,15 +482,11 @@ void showTime(int hour, int minute) {
   // Fine minute granularity
   int fineMinute = minute % 5;
   if (fineMinute == 0) {
-    minuteIndex = (minuteIndex + 1) % 5;
+    balanceMinuteOrder();
   }
-  if (fineMinute > 0) {
-    for (int i = 0; i < fineMinute; i++) {
-      displayWord(w_minutes[(minuteIndex + i) % 5]);
-    }
+  for (int i = 0; i < fineMinute; i++) {
+    displayWord(w_minutes[minuteOrder[i]]);
   }
-
-  updateDisplayAndClearBuffer();
 }
 
 void displayWord(const int word[3]){
@@ -241,33 +495,250 @@ void displayWord(const int word[3]){
   int length = word[2];
 
   for (int i = 0; i < length; i++) {
-    int ledNum = convertFrom2DTo1D(row, col + i);
-    leds_buffer[ledNum] = true;
+    displayLed(row, col + i);
   }
 }
 
+void displayLed(int row, int col) {
+  int ledNum = convertFrom2DTo1D(row, col);
+  if (ledNum < 0) {
+    invalidWordLeds++;
+    return;
+  }
+  frameSetLed(frame, ledNum);
+}
+
+void queueMessage(const char* message) {
+  if (strlen(message) == 0) {
+    return;
+  }
+  if (messageQueueCount == MESSAGE_QUEUE_SIZE) {
+    Log.println("[ERROR] Message queue is full");
+    return;
+  }
+
+  char* slot = messageQueue[(messageQueueHead + messageQueueCount) % MESSAGE_QUEUE_SIZE];
+  strncpy(slot, message, MESSAGE_MAX_LENGTH);
+  slot[MESSAGE_MAX_LENGTH] = '\0';
+  messageQueueCount++;
+  Log.print("Queued message: ");
+  Log.println(slot);
+
+  // a message counts as activity, so it is not scrolled on a dark display
+  lastMotionDetectedMs = millis();
+  updatePowerState();
+}
+
+// Lay out the glyph columns of a message once, so every scroll step only
+// shifts one column in
+void prepareScroll(const char* message) {
+  numScrollColumns = 0;
+
+  for (const char* c = message; *c != '\0'; c++) {
+    const char* glyph = strchr(GLYPH_CHARS, toupper((unsigned char) *c));
+    int glyphIndex = (glyph != NULL) ? glyph - GLYPH_CHARS : 0; // unknown characters are blank
+    for (int i = 0; i < GLYPH_WIDTH; i++) {
+      scrollColumns[numScrollColumns++] = pgm_read_byte(&GLYPHS[glyphIndex][i]);
+    }
+    scrollColumns[numScrollColumns++] = 0;
+  }
+  for (int i = 0; i < NUM_COLS; i++) {
+    scrollColumns[numScrollColumns++] = 0;
+  }
+
+  memset(scrollRows, 0, sizeof(scrollRows));
+  scrollPosition = 0;
+}
+
+void scrollText() {
+  if (!scrolling) {
+    if (messageQueueCount == 0) {
+      return;
+    }
+    prepareScroll(messageQueue[messageQueueHead]);
+    messageQueueHead = (messageQueueHead + 1) % MESSAGE_QUEUE_SIZE;
+    messageQueueCount--;
+    scrolling = true;
+  }
+
+  if (scrollPosition == numScrollColumns) {
+    scrolling = false;
+    showTime();
+    return;
+  }
+
+  // shift every row one column left, carrying the top bit of each word into
+  // the next, and OR in the next column
+  uint8_t column = scrollColumns[scrollPosition++];
+  for (int row = 0; row < GLYPH_HEIGHT; row++) {
+    uint32_t* words = scrollRows[row];
+    for (int word = SCROLL_ROW_WORDS - 1; word > 0; word--) {
+      words[word] = (words[word] << 1) | (words[word - 1] >> 31);
+    }
+    words[0] = (words[0] << 1) | ((column >> row) & 1);
+    words[SCROLL_ROW_WORDS - 1] &= SCROLL_TOP_WORD_MASK;
+
+    for (int word = 0; word < SCROLL_ROW_WORDS; word++) {
+      uint32_t bits = words[word];
+      while (bits != 0) {
+        int bit = (word * 32) + __builtin_ctz(bits);
+        displayLed(SCROLL_TOP_ROW + row, NUM_COLS - 1 - bit);
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  updateDisplayAndClearBuffer();
+}
+
 int convertFrom2DTo1D(int row, int col) {
-  if (SNAKE && (row % 2 == 1)) {
-    return (row * NUM_COLS) + (NUM_COLS - 1 - col) + START_POS;
+  if (row < 0 || row >= GRID_ROWS || col < 0 || col >= NUM_COLS) {
+    return -1;
   }
-  return (row * NUM_COLS) + col + START_POS;
+  return ledMap[row][col];
+}
+
+// Returns false if the tile table is broken, see mapTiles()
+boolean buildLedMap() {
+  LedMapError error;
+  int errors = mapTiles(TILES, NUM_TILES, &ledMap[0][0], GRID_ROWS, NUM_COLS, NUM_LEDS, &error);
+  if (errors == 0) {
+    return true;
+  }
+
+  Log.printf("[ERROR] %d problems in the tile table, first: %s (tile %d, row %d, col %d, LED %d)\n",
+             errors, error.reason, error.tile, error.row, error.col, error.ledNum);
+  return false;
 }
 
 void updateDisplayAndClearBuffer() {
-  for (int i = 0; i < NUM_LEDS; i++) {
-    if (leds_buffer[i] == true) {
-      leds[i] = CRGB::White;
-    } else {
-      leds[i] = CRGB::Black;
-    }
+  // charge the frame that is about to be replaced
+  accountLedUsage();
 
-    // reset buffer
-    leds_buffer[i] = false;
+  if (frameUpdate(frame)) {
+    showLeds();
   }
+}
 
+void showLeds() {
+  accountLedUsage();
+  loopStats.shows++;
+  loopStats.ledBytes += LED_FRAME_BYTES;
   FastLED.show();
 }
 
+void resetLoopStats() {
+  loopStats.startMs = millis();
+  loopStats.loops = 0;
+  loopStats.shows = 0;
+  loopStats.ledBytes = 0;
+  loopStats.logBytes = Log.bytes;
+  loopStats.maxLoopUs = 0;
+  loopStats.busyUs = 0;
+}
+
+void checkLoopStats() {
+  if (millis() - loopStats.startMs >= LOOP_STATS_PERIOD_MS) {
+    reportLoopStats();
+    resetLoopStats();
+  }
+}
+
+void reportLoopStats() {
+  unsigned long elapsedMs = millis() - loopStats.startMs;
+  unsigned long logBytes = Log.bytes - loopStats.logBytes;
+  unsigned long busyMs = loopStats.busyUs / 1000;
+
+  Log.printf("[INFO] Loop statistics for the last %lu s\n", elapsedMs / MS_IN_S);
+  Log.printf("  loops: %lu\n", loopStats.loops);
+  Log.printf("  show() calls: %lu\n", loopStats.shows);
+  Log.printf("  bytes to LEDs: %llu\n", loopStats.ledBytes);
+  Log.printf("  bytes logged: %lu\n", logBytes);
+  Log.printf("  max loop: %lu us\n", loopStats.maxLoopUs);
+  Log.printf("  busy: %lu ms\n", busyMs);
+}
+
+// Charge every lit LED for the time since the last call at the brightness it
+// was shown at.
+void accountLedUsage() {
+  unsigned long now = millis();
+  uint64_t weight = (uint64_t) lastUsageBrightness * (now - lastUsageMs);
+  lastUsageMs = now;
+  lastUsageBrightness = FastLED.getBrightness();
+
+  if (weight == 0) {
+    return;
+  }
+
+  for (int word = 0; word < FRAME_MASK_WORDS; word++) {
+    uint32_t bits = frameMask[word];
+    litBrightnessMs += weight * __builtin_popcount(bits);
+
+    while (bits != 0) {
+      ledUsage[(word * 32) + __builtin_ctz(bits)] += weight;
+      bits &= bits - 1;
+    }
+  }
+}
+
+uint64_t wordUsage(const int word[3]) {
+  uint64_t usage = 0;
+  for (int i = 0; i < word[2]; i++) {
+    int ledNum = convertFrom2DTo1D(word[0], word[1] + i);
+    if (ledNum >= 0) {
+      usage += ledUsage[ledNum];
+    }
+  }
+  return usage;
+}
+
+void balanceMinuteOrder() {
+  // insertion sort, NUM_MINUTES is tiny
+  for (int i = 1; i < NUM_MINUTES; i++) {
+    int minute = minuteOrder[i];
+    uint64_t usage = wordUsage(w_minutes[minute]);
+    int j = i - 1;
+    while (j >= 0 && wordUsage(w_minutes[minuteOrder[j]]) > usage) {
+      minuteOrder[j + 1] = minuteOrder[j];
+      j--;
+    }
+    minuteOrder[j + 1] = minute;
+  }
+}
+
+void loadLedUsage() {
+  ledUsagePrefs.begin("ledusage", false);
+
+  static uint32_t stored[NUM_LEDS];
+  if (ledUsagePrefs.getBytesLength("usage") != sizeof(stored)) {
+    Log.println("  No LED usage stored.");
+    return;
+  }
+  ledUsagePrefs.getBytes("usage", stored, sizeof(stored));
+  for (int i = 0; i < NUM_LEDS; i++) {
+    ledUsage[i] = (uint64_t) stored[i] * USAGE_UNIT_MS;
+  }
+  balanceMinuteOrder();
+}
+
+void saveLedUsage() {
+  accountLedUsage();
+
+  static uint32_t stored[NUM_LEDS];
+  for (int i = 0; i < NUM_LEDS; i++) {
+    stored[i] = ledUsage[i] / USAGE_UNIT_MS;
+  }
+  ledUsagePrefs.putBytes("usage", stored, sizeof(stored));
+}
+
+void printLedUsage() {
+  Log.println("  Fine minute LED usage (brightness x minutes):");
+  for (int i = 0; i < NUM_MINUTES; i++) {
+    Log.printf("    %d: %llu\n", i, (unsigned long long) (wordUsage(w_minutes[i]) / USAGE_UNIT_MS));
+  }
+  Log.printf("  All LEDs: %llu\n", litBrightnessMs / USAGE_UNIT_MS);
+}
+
 void readLight() {
   int lightValue = analogRead(PIN_LIGHT);
 
@@ -277,24 +748,72 @@ void readLight() {
 
 void setBrightness() {
   int brightness = calculateBrightness();
-  
-  long noMotionThreshold = (hour() <= 8) ? NO_MOTION_THRESHOLD_NIGHT_MS : NO_MOTION_THRESHOLD_DAY_MS;
 
-  if (ENABLE_MOTION_SENSOR && (millis() - lastMotionDetectedMs > noMotionThreshold)) {
-    if (logLedSleep) {
-      TelnetStream.println("Sleeping LEDs.");
-      logLedSleep = false;
-    }
-    
+  if (powerState == POWER_DIMMED) {
+    brightness = max(MIN_BRIGHTNESS, brightness / 2);
+  } else if (powerState == POWER_DISPLAY_OFF || powerState == POWER_DEEP_IDLE) {
     brightness = 0;
-  } else {
-    logLedSleep = true;
   }
 
-
   smoothToBrightness(brightness);
 }
 
+PowerState nextPowerState(unsigned long msSinceMotion, unsigned long noMotionThreshold) {
+  if (!ENABLE_MOTION_SENSOR) {
+    return POWER_ACTIVE;
+  }
+  if (msSinceMotion > noMotionThreshold + DEEP_IDLE_AFTER_MS) {
+    return POWER_DEEP_IDLE;
+  }
+  if (msSinceMotion > noMotionThreshold) {
+    return POWER_DISPLAY_OFF;
+  }
+  if (msSinceMotion + DIM_BEFORE_OFF_MS > noMotionThreshold) {
+    return POWER_DIMMED;
+  }
+  return POWER_ACTIVE;
+}
+
+void updatePowerState() {
+  unsigned long noMotionThreshold = (hour() <= 8) ? NO_MOTION_THRESHOLD_NIGHT_MS : NO_MOTION_THRESHOLD_DAY_MS;
+  PowerState state = nextPowerState(millis() - lastMotionDetectedMs, noMotionThreshold);
+
+  if (state != powerState) {
+    enterPowerState(state);
+  }
+}
+
+void enterPowerState(PowerState state) {
+  const PowerProfile& profile = powerProfiles[state];
+  boolean waking = (powerState == POWER_DISPLAY_OFF || powerState == POWER_DEEP_IDLE)
+                && (state == POWER_ACTIVE || state == POWER_DIMMED);
+
+  Log.print("Power state: ");
+  Log.println(profile.name);
+  powerState = state;
+  applyPowerProfile();
+
+  // don't wait for the next task run to bring the display back
+  if (waking) {
+    showTime();
+  }
+  setBrightness();
+}
+
+// CPU clock, WiFi power save and task intervals of the current power state
+void applyPowerProfile() {
+  const PowerProfile& profile = powerProfiles[powerState];
+
+  if (getCpuFrequencyMhz() != profile.cpuMhz) {
+    setCpuFrequencyMhz(profile.cpuMhz);
+  }
+  WiFi.setSleep(profile.wifiPowerSave);
+
+  tasks[TASK_SHOW_TIME].interval = profile.showTimeInterval;
+  tasks[TASK_READ_LIGHT].interval = profile.readLightInterval;
+  tasks[TASK_BRIGHTNESS].interval = profile.brightnessInterval;
+}
+
 void smoothToBrightness(int brightness) {
   int currentBrightness = FastLED.getBrightness();
 
@@ -304,7 +823,7 @@ void smoothToBrightness(int brightness) {
 
   if (currentBrightness == 0) {
   	FastLED.setBrightness(brightness);
-    FastLED.show();
+    showLeds();
     return;
   }
 
@@ -313,16 +832,21 @@ void smoothToBrightness(int brightness) {
   	return;
   }
 
+  // round the step up so a fade never takes more than FADE_STEPS steps
   int difference = brightness - currentBrightness;
-  int delta = difference / FADE_STEPS;
+  int delta = (abs(difference) + FADE_STEPS - 1) / FADE_STEPS;
 
-  if (delta == 0) {
-    delta = (difference < 0) ? -1 : 1;
+  if (difference < 0) {
+    delta = -delta;
   }
 
   while (currentBrightness != brightness) {
     currentBrightness += delta;
 
+    // the last step may not be a full one
+    if ((delta > 0) ? (currentBrightness > brightness) : (currentBrightness < brightness)) {
+      currentBrightness = brightness;
+    }
     if (currentBrightness < MIN_BRIGHTNESS) {
       currentBrightness = MIN_BRIGHTNESS;
     }
@@ -331,7 +855,7 @@ void smoothToBrightness(int brightness) {
     }
     
     FastLED.setBrightness(currentBrightness);
-    FastLED.show();
+    showLeds();
 
     if (currentBrightness == MIN_BRIGHTNESS || currentBrightness == MAX_BRIGHTNESS) {
       break;
@@ -343,11 +867,7 @@ void smoothToBrightness(int brightness) {
 
 void smoothToZero() {
   int currentBrightness = FastLED.getBrightness();
-  int delta = currentBrightness / FADE_STEPS;
-
-  if (delta == 0) {
-    delta = 1;
-  }
+  int delta = (currentBrightness + FADE_STEPS - 1) / FADE_STEPS;
 
   while (currentBrightness != 0) {
     currentBrightness -= delta;
@@ -357,7 +877,7 @@ void smoothToZero() {
     }
 
     FastLED.setBrightness(currentBrightness);
-    FastLED.show();
+    showLeds();
 
     delay(MS_IN_S / FADE_STEPS);
   }
@@ -369,11 +889,11 @@ int calculateBrightness() {
   int brightness = constrain(map(averageLight, 0, 3000, MIN_BRIGHTNESS, MAX_BRIGHTNESS), MIN_BRIGHTNESS, MAX_BRIGHTNESS);
 
   if (LOG_BRIGHTNESS) {
-    TelnetStream.print("Average LDR: ");
-    TelnetStream.println(averageLight, DEC);
-    TelnetStream.print("Brightness: ");
-    TelnetStream.println(brightness, DEC);
-    TelnetStream.println("");
+    Log.print("Average LDR: ");
+    Log.println(averageLight, DEC);
+    Log.print("Brightness: ");
+    Log.println(brightness, DEC);
+    Log.println("");
   }
 
   return brightness;
@@ -387,12 +907,32 @@ double getAverageLight() {
   return sum / LIGHT_BUFFER_SIZE;
 }
 
+void IRAM_ATTR onMotionEdge() {
+  motionQueuePush(motionQueue, millis(), digitalRead(PIN_MOTION));
+}
+
 void checkMotion() {
-  boolean motion = digitalRead(PIN_MOTION);
-  if (motion != lastMotion) {
-    TelnetStream.println("Motion change detected");
-    lastMotion = motion;
-    lastMotionDetectedMs = millis();
+  boolean changed = false;
+  MotionEdge edge;
+  while (motionQueuePop(motionQueue, edge)) {
+    if (edge.motion != lastMotion) {
+      lastMotion = edge.motion;
+      lastMotionDetectedMs = edge.ms;
+      changed = true;
+    }
+  }
+
+  uint32_t dropped = motionQueueTakeDropped(motionQueue);
+  if (dropped > 0) {
+    Log.print("[WARNING] Motion edges dropped: ");
+    Log.println(dropped, DEC);
+  }
+
+  if (changed) {
+    Log.println("Motion change detected");
+
+    // wake the display right away instead of waiting for the power state task
+    updatePowerState();
   }
 }
 
@@ -401,61 +941,226 @@ void simulateClock() {
   for (int i = 0; i < 12; i++) {
     for (int j = 0; j < 60; j++) {
       showTime(i, j);
+      heartbeatMs = millis(); // slow on purpose, not a stall
       delay(500);
     }
   }
 }
 
 void printMenu() {
-  TelnetStream.println("");
-  TelnetStream.println("Menu");
-  TelnetStream.println("----");
-  TelnetStream.println("  1. Set brightness override");
-  TelnetStream.println("  2. Read brightness override");
-  TelnetStream.println("  3. Simulate for testing");
-  TelnetStream.println("");
+  Log.println("");
+  Log.println("Menu");
+  Log.println("----");
+  Log.println("  1. Set brightness override");
+  Log.println("  2. Read brightness override");
+  Log.println("  3. Simulate for testing");
+  Log.println("  4. Print loop statistics");
+  Log.println("  5. Print LED usage");
+  Log.println("  6. Scroll a message");
+  Log.println("");
+}
+
+const char* taskName(int task) {
+  if (task == SETUP_WIFI) {
+    return "setup: wifi";
+  }
+  if (task == SETUP_TIME_SYNC) {
+    return "setup: time sync";
+  }
+  return (task >= 0 && task < NUM_TASKS) ? tasks[task].name : "loop";
+}
+
+void enterTask(int task) {
+  unsigned long now = millis();
+  currentTaskStartMs = now;
+  currentTask = task;
+
+  TaskEntry& entry = stallRecord.ring[stallRecord.ringIndex % STALL_RING_SIZE];
+  entry.task = task;
+  entry.ms = now;
+  stallRecord.ringIndex++;
+}
+
+// Watch a phase of setup() like a task, with its own STALL_THRESHOLD_MS
+void enterSetupPhase(int phase) {
+  heartbeatMs = millis();
+  enterTask(phase);
+}
+
+// No logging here: the loop may be stuck in a TelnetStream write
+void stallWatchdogTask(void* parameter) {
+  for (;;) {
+    vTaskDelay(STALL_CHECK_MS / portTICK_PERIOD_MS);
+
+    unsigned long sinceHeartbeatMs = millis() - heartbeatMs;
+    if (sinceHeartbeatMs < STALL_THRESHOLD_MS) {
+      continue;
+    }
+
+    stallRecord.task = currentTask;
+    stallRecord.stalledMs = millis() - currentTaskStartMs;
+    stallRecord.stalled = true;
+
+    if (sinceHeartbeatMs >= STALL_RESTART_MS) {
+      ESP.restart();
+    }
+  }
+}
+
+// Keep the record of the last boot for reportBootStall(), then start watching
+void setupStallWatchdog() {
+  if (stallRecord.magic != STALL_RECORD_MAGIC) {
+    // power on, RTC memory holds garbage
+    memset(&stallRecord, 0, sizeof(stallRecord));
+    stallRecord.magic = STALL_RECORD_MAGIC;
+  }
+  bootStallRecord = stallRecord;
+  stallRecord.stalled = false;
+
+  heartbeatMs = millis();
+  xTaskCreatePinnedToCore(stallWatchdogTask, "STALL_WDT", 4096, NULL, configMAX_PRIORITIES - 1, NULL, 0);
+}
+
+// Called once the log reaches somebody, i.e. after the WiFi connects
+void reportBootStall() {
+  if (bootStallRecord.stalled) {
+    reportStall(bootStallRecord, "[ERROR] Restarted after the loop stalled");
+  }
+}
+
+// Called by loop() when the watchdog saw a stall the loop came back from
+void reportRecoveredStall() {
+  StallRecord record = stallRecord;
+  stallRecord.stalled = false;
+  reportStall(record, "[WARNING] Loop stalled");
+}
+
+void reportStall(const StallRecord& record, const char* what) {
+  Log.printf("%s in %s for %lu ms\n", what, taskName(record.task), (unsigned long) record.stalledMs);
+  Log.println("  Last tasks entered:");
+
+  uint32_t count = min(record.ringIndex, (uint32_t) STALL_RING_SIZE);
+  for (uint32_t i = record.ringIndex - count; i != record.ringIndex; i++) {
+    const TaskEntry& entry = record.ring[i % STALL_RING_SIZE];
+    Log.printf("    %10lu ms  %s\n", (unsigned long) entry.ms, taskName(entry.task));
+  }
+}
+
+void loadTasks() {
+  const PowerProfile& profile = powerProfiles[powerState];
+
+  // Show time
+  tasks[TASK_SHOW_TIME].name = "show time";
+  tasks[TASK_SHOW_TIME].previous = 0;
+  tasks[TASK_SHOW_TIME].interval = profile.showTimeInterval;
+  tasks[TASK_SHOW_TIME].function = showTime;
+
+  // ezTime updates
+  tasks[TASK_EVENTS].name = "ezTime events";
+  tasks[TASK_EVENTS].previous = 0;
+  tasks[TASK_EVENTS].interval = 30000;
+  tasks[TASK_EVENTS].function = events;
+
+  // Move between power states when there has been no motion
+  tasks[TASK_POWER_STATE].name = "power state";
+  tasks[TASK_POWER_STATE].previous = 0;
+  tasks[TASK_POWER_STATE].interval = 1000;
+  tasks[TASK_POWER_STATE].function = updatePowerState;
+
+  // Read light sensor
+  tasks[TASK_READ_LIGHT].name = "read light";
+  tasks[TASK_READ_LIGHT].previous = 0;
+  tasks[TASK_READ_LIGHT].interval = profile.readLightInterval;
+  tasks[TASK_READ_LIGHT].function = readLight;
+
+  // Adjust brightness
+  tasks[TASK_BRIGHTNESS].name = "brightness";
+  tasks[TASK_BRIGHTNESS].previous = 0;
+  tasks[TASK_BRIGHTNESS].interval = profile.brightnessInterval;
+  tasks[TASK_BRIGHTNESS].function = setBrightness;
+
+  // Listen for input on the serial interface
+  tasks[TASK_SERIAL_MENU].name = "serial menu";
+  tasks[TASK_SERIAL_MENU].previous = 0;
+  tasks[TASK_SERIAL_MENU].interval = 100;
+  tasks[TASK_SERIAL_MENU].function = serialMenu;
+
+  // Report loop statistics once a day
+  tasks[TASK_LOOP_STATS].name = "loop statistics";
+  tasks[TASK_LOOP_STATS].previous = 0;
+  tasks[TASK_LOOP_STATS].interval = 60000;
+  tasks[TASK_LOOP_STATS].function = checkLoopStats;
+
+  // Store LED usage every hour
+  tasks[TASK_LED_USAGE].name = "led usage";
+  tasks[TASK_LED_USAGE].previous = millis();
+  tasks[TASK_LED_USAGE].interval = 60UL * 60 * 1000;
+  tasks[TASK_LED_USAGE].function = saveLedUsage;
+
+  // Scroll queued messages
+  tasks[TASK_SCROLL_TEXT].name = "scroll text";
+  tasks[TASK_SCROLL_TEXT].previous = 0;
+  tasks[TASK_SCROLL_TEXT].interval = SCROLL_STEP_MS;
+  tasks[TASK_SCROLL_TEXT].function = scrollText;
 }
 
 void setup() {
   Serial.begin(9600);
   delay(500);
 
-  TelnetStream.println("[INFO] Wordclock is booting...");
+  Log.println("[INFO] Wordclock is booting...");
 
-  TelnetStream.println("[INFO] OTA");
+  Log.println("[INFO] OTA");
   setupOTA("wordclock", mySSID, myPASSWORD);
   delay(1000);
   
-  TelnetStream.println("[INFO] LEDs");
+  Log.println("[INFO] LEDs");
+  buildLedMap();
+  loadLedUsage();
+  // one strip drives all tiles; parallel strips are added per run, e.g.
+  // FastLED.addLeds<SK9822, PIN, PIN, BGR>(leds + firstLed, numLeds);
   FastLED.addLeds<SK9822, PIN_LED_DATA, PIN_LED_CLOCK, BGR>(leds, NUM_LEDS);
   FastLED.setBrightness(MAX_BRIGHTNESS);
   set_max_power_in_volts_and_milliamps(5, 500); 
 
-  TelnetStream.println("[INFO] Wifi");
-  TelnetStream.printf("Connecting to %s ", mySSID);
+  Log.println("[INFO] Tasks");
+  loadTasks();
+  setupStallWatchdog(); // before connecting, a hang there restarts the clock
+
+  Log.println("[INFO] Wifi");
+  Log.printf("Connecting to %s ", mySSID);
+  enterSetupPhase(SETUP_WIFI);
   WiFi.begin(mySSID, myPASSWORD);
   while (WiFi.status() != WL_CONNECTED) {
       delay(500);
-      TelnetStream.print(".");
+      Log.print(".");
   }
-  TelnetStream.println(" CONNECTED");
+  Log.println(" CONNECTED");
+  reportBootStall();
+  setupOTAStream(myPASSWORD);
 
-  TelnetStream.println("[INFO] Time");
+  Log.println("[INFO] Time");
+  enterSetupPhase(SETUP_TIME_SYNC);
   waitForSync();
-  TelnetStream.println("  UTC: " + UTC.dateTime());
+  Log.println("  UTC: " + UTC.dateTime());
 	localTimezone.setLocation(LOCAL_TIMEZONE_LOCATION);
   localTimezone.setDefault();
-	TelnetStream.println("  Local time: " + localTimezone.dateTime());
+	Log.println("  Local time: " + localTimezone.dateTime());
   setInterval(60 * 15); // sync every 15 minutes
-  
-  // TelnetStream.println("[INFO] Tasks");
-  // loadTasks();
+  enterSetupPhase(LOOP_TASK);
+
+  applyPowerProfile(); // boot in the same state the profile describes
+  resetLoopStats();
 
-  TelnetStream.println("[INFO] Motion sensor");
+  Log.println("[INFO] Motion sensor");
   pinMode(PIN_MOTION, INPUT);
+  lastMotion = digitalRead(PIN_MOTION);
   lastMotionDetectedMs = millis();
+  if (ENABLE_MOTION_SENSOR) {
+    attachInterrupt(digitalPinToInterrupt(PIN_MOTION), onMotionEdge, CHANGE);
+  }
 
-  TelnetStream.println("[INFO] Wordclock done booting. Hello World!");
+  Log.println("[INFO] Wordclock done booting. Hello World!");
   printMenu();
 }
 
@@ -464,28 +1169,35 @@ void loop() {
   //   simulateClock();
   // }
 
-  // Show time
-  EVERY_N_SECONDS(1) {
-    showTime();
-  }
-
-  // ezTime updates
-  EVERY_N_SECONDS(30) {
-    events();
+  unsigned long loopStartUs = micros();
+  heartbeatMs = millis();
+  if (stallRecord.stalled) {
+    reportRecoveredStall();
   }
 
-  // Toggle motion detector
-  EVERY_N_SECONDS(1) {
-    checkMotion();
+  // Drain motion edges from the interrupt handler
+  checkMotion();
+
+  unsigned long time = millis();
+  for (int i = 0; i < NUM_TASKS; i++) {
+    if (time - tasks[i].previous >= tasks[i].interval) {
+      unsigned long taskStartUs = micros();
+      tasks[i].previous = time;
+      enterTask(i);
+      tasks[i].function();
+      currentTask = LOOP_TASK;
+      loopStats.busyUs += micros() - taskStartUs;
+    }
   }
 
-  // Read light sensor
-  EVERY_N_MILLISECONDS(250) {
-    readLight();
+  unsigned long loopUs = micros() - loopStartUs;
+  loopStats.loops++;
+  if (loopUs > loopStats.maxLoopUs) {
+    loopStats.maxLoopUs = loopUs;
   }
 
-  // Adjust brightness
-  EVERY_N_SECONDS(2) {
-    setBrightness();
+  // let the CPU idle while the display is off
+  if (powerProfiles[powerState].loopDelayMs > 0) {
+    delay(powerProfiles[powerState].loopDelayMs);
   }
-}
\ No newline at end of file
+}